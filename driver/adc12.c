@@ -44,11 +44,11 @@
 
 // driver
 #include "adc12.h"
-#include "timer.h"
 
 
 // *************************************************************************************************
 // Prototypes section
+void start_adc12_sequence(void);
 
 
 // *************************************************************************************************
@@ -57,144 +57,177 @@
 
 // *************************************************************************************************
 // Global Variable section
-u16 adc12_result;
-u8  adc12_data_ready;
+struct adc12 sAdc12;
 
 
 // *************************************************************************************************
 // Extern section
 
 
-//
-//
-//// *************************************************************************************************
-//// @fn          adc12_single_conversion
-//// @brief       Init ADC12. Do single conversion. Turn off ADC12.
-//// @param       none
-//// @return      none
-//// *************************************************************************************************
-//u16 adc12_single_conversion(u16 ref_v, u16 adc12_sht, u16 adc12_ssel, u16 adc12_vref, u16 adc12_channel, u16 adc12_conv_delay)
-//{
-//	u16 adc12_result;
-//
-//	// Set REF reference voltage to 1.5V (temperature) or 2.5V (battery)	
-//	REFCTL0 |= REFMSTR + REFON + ref_v;           
-//
-//	// Initialize ADC12 
-//	ADC12CTL0 = ADC12ON +  adc12_sht;
-//	ADC12CTL1 = ADC12SHP + adc12_ssel;        	// Use sampling timer, ADC12CLK = ACLK
-//	ADC12CTL2 = ADC12RES_2 + ADC12SR;       	// 12-bit mode, 50ksps
-//	ADC12MCTL0 = adc12_vref + adc12_channel; 	// Set reference, set input channel
-//
-//	// Wait until ADC12 reference voltage has settled
-//	Timer0_A4_Delay(CONV_US_TO_TICKS(ADC12_REFERENCE_SETTLING_TIME_USEC));
-//
-//	// Start conversion
-//	ADC12CTL0 |= ADC12ENC | ADC12SC;
-//
-//	// Wait until ADC12 has finished
-//	Timer0_A4_Delay(CONV_US_TO_TICKS(adc12_conv_delay));
-//	while ((ADC12CTL1 & ADC12BUSY) == ADC12BUSY);
-//	
-//	// Store measurement result 
-//	adc12_result = ADC12MEM0; 
-//	
-//	// Shut down ADC12
-//	ADC12CTL0 &= ~(ADC12ENC | ADC12SC);
-//	ADC12CTL0 &= ~ADC12ON;
-//	
-//	// Shut down reference voltage 	
-//	REFCTL0 &= ~(REFMSTR + REFVSEL_2 + REFON); 
-//	
-//	// Return ADC result
-//	return (adc12_result);
-//}
+// *************************************************************************************************
+// @fn          adc12_request_conversion
+// @brief       Queue a conversion. Queued channels are converted together in one sequence that
+//				is started from the idle loop. The callback receives the result in main context.
+// @param       u16 channel		ADC12INCH_x
+//				void (*callback)(u16 result)	Result handler
+// @return      u8				1 = queued or already queued, 0 = queue full
+// *************************************************************************************************
+u8 adc12_request_conversion(u16 channel, void (*callback)(u16 result))
+{
+	u8 i;
+
+	// A channel queued for the next sequence is converted only once
+	for (i=sAdc12.sequence; i<sAdc12.count; i++)
+	{
+		if ((sAdc12.request[i].channel == channel) && (sAdc12.request[i].callback == callback)) return (1);
+	}
+	
+	if (sAdc12.count >= ADC12_QUEUE_LENGTH) return (0);
+	
+	sAdc12.request[sAdc12.count].channel  = channel;
+	sAdc12.request[sAdc12.count].callback = callback;
+	sAdc12.count++;
+	
+	return (1);
+}
 
 
 // *************************************************************************************************
-// @fn          adc12_single_conversion
-// @brief       Init ADC12. Do single conversion. Turn off ADC12.
+// @fn          start_adc12_sequence
+// @brief       Convert all queued channels in one sequence. The reference is powered up once, the
+//				sample time of the first channel covers its settling time. ADC12ISR is called
+//				after the last channel.
 // @param       none
 // @return      none
 // *************************************************************************************************
-u16 adc12_single_conversion(u16 ref, u16 sht, u16 channel)
+void start_adc12_sequence(void)
 {
+	u8 i;
+	
+	sAdc12.sequence = sAdc12.count;
+	sAdc12.done     = 0;
+	
 	// Initialize the shared reference module 
-	REFCTL0 |= REFMSTR + ref + REFON;    		// Enable internal reference (1.5V or 2.5V)
+	REFCTL0 |= REFMSTR + ADC12_REFERENCE + REFON;
   
-	// Initialize ADC12_A 
-	ADC12CTL0 = sht + ADC12ON;					// Set sample time 
-	ADC12CTL1 = ADC12SHP;                     	// Enable sample timer
-	ADC12MCTL0 = ADC12SREF_1 + channel;  		// ADC input channel  
-	ADC12IE = 0x001;                          	// ADC_IFG upon conv result-ADCMEMO
+	// Initialize ADC12_A: one trigger converts the whole sequence
+	ADC12CTL0 = ADC12_SAMPLE_TIME + ADC12MSC + ADC12ON;
+	ADC12CTL1 = ADC12SHP + ADC12CONSEQ_1;
+	for (i=0; i<sAdc12.sequence; i++)
+	{
+		(&ADC12MCTL0)[i] = ADC12SREF_1 + sAdc12.request[i].channel;
+	}
+	(&ADC12MCTL0)[sAdc12.sequence-1] |= ADC12EOS;
+	ADC12IFG = 0;
+	ADC12IE  = 1u << (sAdc12.sequence-1);
   
-  	// Wait 2 ticks (66us) to allow internal reference to settle
-	Timer0_A4_Delay(2);       
-	
-	// Start ADC12
-	ADC12CTL0 |= ADC12ENC;                             		  	
-
-	// Clear data ready flag
-  	adc12_data_ready = 0;
-  	
-  	// Sampling and conversion start  
-    ADC12CTL0 |= ADC12SC;                   	
-    
-    // Wait until ADC12 has finished
-    Timer0_A4_Delay(5);       
-	while (!adc12_data_ready);
-	
-	// Shut down ADC12
-	ADC12CTL0 &= ~(ADC12ENC | ADC12SC | sht);
-	ADC12CTL0 &= ~ADC12ON;
-	
-	// Shut down reference voltage 	
-	REFCTL0 &= ~(REFMSTR + ref + REFON); 
-	
-	ADC12IE = 0;                          	
-	
-	// Return ADC result
-	return (adc12_result);
+	// Sampling and conversion start  
+	ADC12CTL0 |= ADC12ENC + ADC12SC;
+}
+
+
+// *************************************************************************************************
+// @fn          is_adc12_pending
+// @brief       Returns 1 if results are waiting for delivery or a sequence can be started.
+// @param       none
+// @return      u8
+// *************************************************************************************************
+u8 is_adc12_pending(void)
+{
+	return (sAdc12.done || ((sAdc12.sequence == 0) && (sAdc12.count > 0)));
 }
 
 
+// *************************************************************************************************
+// @fn          process_adc12
+// @brief       Deliver the results of a finished sequence to the callbacks, then start the next
+//				sequence if conversions are queued.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void process_adc12(void)
+{
+	void (*callback[ADC12_QUEUE_LENGTH])(u16 result);
+	u16 result[ADC12_QUEUE_LENGTH];
+	u8 i, n;
+
+	if (sAdc12.done)
+	{
+		// Remove finished requests first, callbacks may queue new conversions
+		n = sAdc12.sequence;
+		for (i=0; i<n; i++)
+		{
+			callback[i] = sAdc12.request[i].callback;
+			result[i]   = sAdc12.result[i];
+		}
+		for (i=n; i<sAdc12.count; i++)
+		{
+			sAdc12.request[i-n] = sAdc12.request[i];
+		}
+		sAdc12.count   -= n;
+		sAdc12.sequence = 0;
+		sAdc12.done     = 0;
+		
+		for (i=0; i<n; i++) callback[i](result[i]);
+	}
+
+	if ((sAdc12.sequence == 0) && (sAdc12.count > 0)) start_adc12_sequence();
+}
+
+
+// *************************************************************************************************
+// @fn          adc12_flush
+// @brief       Convert all queued channels and deliver the results before returning. For callers
+//				that need the result at once and do not return to the idle loop.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void adc12_flush(void)
+{
+	while (sAdc12.count > 0)
+	{
+		if (is_adc12_pending())
+		{
+			process_adc12();
+		}
+		else
+		{
+			// Sleep until ADC12ISR has stored the results
+			__disable_interrupt();
+			if (!sAdc12.done) _BIS_SR(LPM3_bits + GIE);
+			__enable_interrupt();
+		}
+	}
+}
 
 
 // *************************************************************************************************
 // @fn          ADC12ISR
-// @brief       Store ADC12 conversion result. Set flag to indicate data ready.
+// @brief       Store results of the sequence. Turn off ADC12 and reference. 
 // @param       none
 // @return      none
 // *************************************************************************************************
 #pragma vector=ADC12_VECTOR
 __interrupt void ADC12ISR (void)
 {
-  switch(__even_in_range(ADC12IV,34))
-  {
-  case  0: break;                           // Vector  0:  No interrupt
-  case  2: break;                           // Vector  2:  ADC overflow
-  case  4: break;                           // Vector  4:  ADC timing overflow
-  case  6:                                  // Vector  6:  ADC12IFG0
-    		adc12_result = ADC12MEM0;                       // Move results, IFG is cleared
-    		adc12_data_ready = 1;
-    		_BIC_SR_IRQ(LPM3_bits);   						// Exit active CPU
-    		break;
-  case  8: break;                           // Vector  8:  ADC12IFG1
-  case 10: break;                           // Vector 10:  ADC12IFG2
-  case 12: break;                           // Vector 12:  ADC12IFG3
-  case 14: break;                           // Vector 14:  ADC12IFG4
-  case 16: break;                           // Vector 16:  ADC12IFG5
-  case 18: break;                           // Vector 18:  ADC12IFG6
-  case 20: break;                           // Vector 20:  ADC12IFG7
-  case 22: break;                           // Vector 22:  ADC12IFG8
-  case 24: break;                           // Vector 24:  ADC12IFG9
-  case 26: break;                           // Vector 26:  ADC12IFG10
-  case 28: break;                           // Vector 28:  ADC12IFG11
-  case 30: break;                           // Vector 30:  ADC12IFG12
-  case 32: break;                           // Vector 32:  ADC12IFG13
-  case 34: break;                           // Vector 34:  ADC12IFG14
-  default: break;
-  }
+	u8 i;
+	
+	// Reading the result registers clears the IFGs
+	for (i=0; i<sAdc12.sequence; i++)
+	{
+		sAdc12.result[i] = (&ADC12MEM0)[i];
+	}
+	
+	// Shut down ADC12
+	ADC12IE = 0;
+	ADC12CTL0 &= ~(ADC12ENC | ADC12SC);
+	ADC12CTL0 &= ~ADC12ON;
+	
+	// Shut down reference voltage 	
+	REFCTL0 &= ~(REFMSTR + ADC12_REFERENCE + REFON); 
+	
+	sAdc12.done = 1;
+	
+	// Exit active CPU
+	_BIC_SR_IRQ(LPM3_bits);
 }
-
-
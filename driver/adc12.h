@@ -42,25 +42,48 @@
 
 // *************************************************************************************************
 // Prototypes section
-extern u16 adc12_single_conversion(u16 ref, u16 sht, u16 channel);
+extern u8 adc12_request_conversion(u16 channel, void (*callback)(u16 result));
+extern u8 is_adc12_pending(void);
+extern void process_adc12(void);
+extern void adc12_flush(void);
 
 // *************************************************************************************************
 // Defines section
 
-//// Reference settling time
-//#define ADC12_REFERENCE_SETTLING_TIME_USEC		(4*34u)	
-//
-//// Delay for temperature measurement
-//#define ADC12_TEMP_CONVERSION_TIME_USEC			(10*34u)	
-//
-//// Delay for battery voltage measurement
-//#define ADC12_BATT_CONVERSION_TIME_USEC			(10*34u)	
+// Conversions queued until the next sequence starts (one per ADC12MCTLx register used)
+#define ADC12_QUEUE_LENGTH			(4u)
+
+// Reference shared by all channels of a sequence: 2.0V covers AVCC/2 of a fresh battery
+#define ADC12_REFERENCE				(REFVSEL_1)
+
+// 512 ADC12CLK cycles (around 100us at MODOSC): the first sample covers the reference settling
+// time, the temperature sensor needs at least 30us
+#define ADC12_SAMPLE_TIME			(ADC12SHT0_10)
 
 
 // *************************************************************************************************
 // Global Variable section
-extern u16 adc12_result;
-extern u8  adc12_data_ready;
+struct adc12_request
+{
+	// ADC12INCH_x
+	u16			channel;
+	
+	// Called with the result from the idle loop
+	void		(*callback)(u16 result);
+};
+
+struct adc12
+{
+	// Queued requests, the first sequence entries are being converted
+	struct adc12_request request[ADC12_QUEUE_LENGTH];
+	u8			count;
+	u8			sequence;
+	
+	// Results of the sequence, done = 1 after the last conversion
+	u16			result[ADC12_QUEUE_LENGTH];
+	volatile u8	done;
+};
+extern struct adc12 sAdc12;
 
 
 // *************************************************************************************************
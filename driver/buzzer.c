@@ -64,11 +64,13 @@ void countdown_buzzer(void);
 // *************************************************************************************************
 // Global Variable section
 struct buzzer sBuzzer;
+
+// Buzzer on/off timer
+struct soft_timer buzzer_timer;
  
 
 // *************************************************************************************************
 // Extern section
-//extern u16 timer0_A3_ticks_g;
 
 
 
@@ -115,12 +117,8 @@ void start_buzzer(u8 cycles, u16 on_time, u16 off_time)
 		// Allow buzzer PWM output on P2.7
 		P2SEL |= BIT7;
 
-		// Activate Timer0_A3 periodic interrupts
-		fptr_Timer0_A3_function = toggle_buzzer;
-		Timer0_A3_Start(sBuzzer.on_time);
-
-		// Preload timer advance variable
-		sTimer.timer0_A3_ticks = sBuzzer.off_time;
+		// Turn off output after on_time
+		start_soft_timer(&buzzer_timer, sBuzzer.on_time, 0, toggle_buzzer);
 
 		// Start with buzzer output on
 		sBuzzer.state 	 	= BUZZER_ON_OUTPUT_ENABLED;
@@ -150,8 +148,8 @@ void toggle_buzzer(void)
 		// Update buzzer state
 		sBuzzer.state = BUZZER_ON_OUTPUT_DISABLED;
 		
-		// Reload Timer0_A4 IRQ to restart output
-		sTimer.timer0_A3_ticks = sBuzzer.on_time;
+		// Restart output after off_time
+		start_soft_timer(&buzzer_timer, sBuzzer.off_time, 0, toggle_buzzer);
 	}
 	else // Turn on buzzer
 	{
@@ -171,8 +169,8 @@ void toggle_buzzer(void)
 			// Update buzzer state
 			sBuzzer.state = BUZZER_ON_OUTPUT_ENABLED;
 	
-			// Reload Timer0_A4 IRQ to turn off output
-			sTimer.timer0_A3_ticks = sBuzzer.off_time;
+			// Turn off output after on_time
+			start_soft_timer(&buzzer_timer, sBuzzer.on_time, 0, toggle_buzzer);
 		}
 	}
 }
@@ -196,8 +194,8 @@ void stop_buzzer(void)
 	// Clear PWM timer interrupt    
 	TA1CCTL0 &= ~CCIE; 
 
-	// Disable periodic start/stop interrupts
-	Timer0_A3_Stop();
+	// Disable start/stop timer
+	stop_soft_timer(&buzzer_timer);
 
 	// Clear variables
 	reset_buzzer();
@@ -0,0 +1,128 @@
+// *************************************************************************************************
+//
+//	Copyright (C) 2009 Texas Instruments Incorporated - http://www.ti.com/ 
+//	 
+//	 
+//	  Redistribution and use in source and binary forms, with or without 
+//	  modification, are permitted provided that the following conditions 
+//	  are met:
+//	
+//	    Redistributions of source code must retain the above copyright 
+//	    notice, this list of conditions and the following disclaimer.
+//	 
+//	    Redistributions in binary form must reproduce the above copyright
+//	    notice, this list of conditions and the following disclaimer in the 
+//	    documentation and/or other materials provided with the   
+//	    distribution.
+//	 
+//	    Neither the name of Texas Instruments Incorporated nor the names of
+//	    its contributors may be used to endorse or promote products derived
+//	    from this software without specific prior written permission.
+//	
+//	  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+//	  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+//	  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+//	  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+//	  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+//	  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+//	  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//	  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+//	  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+//	  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+//	  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *************************************************************************************************
+
+// Event ring from the ISRs to the main loop. Each event is stored with its own slot, so events of
+// the same type arriving before the main loop runs are neither merged nor lost. An event that
+// does not fit is counted per type.
+// *************************************************************************************************
+
+
+// *************************************************************************************************
+// Include section
+
+// system
+#include "project.h"
+
+// driver
+#include "event.h"
+
+
+// *************************************************************************************************
+// Prototypes section
+
+
+// *************************************************************************************************
+// Defines section
+
+
+// *************************************************************************************************
+// Global Variable section
+struct events sEvents;
+
+
+// *************************************************************************************************
+// Extern section
+
+
+// *************************************************************************************************
+// @fn          post_event
+// @brief       Add an event to the ring. Call from ISR context only.
+// @param       u8 type			EVENT_xxx
+//				u16 payload		Event data
+// @return      u8				1 = event posted, 0 = ring full, event counted as overflow
+// *************************************************************************************************
+u8 post_event(u8 type, u16 payload)
+{
+	struct event * event;
+	u8 fill = (u8)(sEvents.write - sEvents.read);
+
+	if (fill >= EVENT_RING_SIZE)
+	{
+		if (sEvents.overflow[type] < 0xFFFF) sEvents.overflow[type]++;
+		return (0);
+	}
+
+	event = &sEvents.ring[sEvents.write & (EVENT_RING_SIZE - 1)];
+	event->type    = type;
+	event->payload = payload;
+	event->time    = TA0R;
+
+	if (++fill > sEvents.max_fill) sEvents.max_fill = fill;
+
+	// Slot is complete, hand it over to the main loop
+	sEvents.write++;
+	return (1);
+}
+
+
+// *************************************************************************************************
+// @fn          get_event
+// @brief       Take the oldest event out of the ring. Call from main loop only.
+// @param       struct event * event	Buffer for the event
+// @return      u8						1 = event copied, 0 = ring empty
+// *************************************************************************************************
+u8 get_event(struct event * event)
+{
+	// Write index is only advanced by ISRs, a stale value just delays the event
+	if (sEvents.read == sEvents.write) return (0);
+
+	*event = sEvents.ring[sEvents.read & (EVENT_RING_SIZE - 1)];
+
+	// Release slot for ISRs
+	sEvents.read++;
+	return (1);
+}
+
+
+// *************************************************************************************************
+// @fn          is_event_pending
+// @brief       Returns 1 if events wait in the ring.
+// @param       none
+// @return      u8				1 = event pending
+// *************************************************************************************************
+u8 is_event_pending(void)
+{
+	return (sEvents.read != sEvents.write);
+}
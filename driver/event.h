@@ -0,0 +1,104 @@
+// *************************************************************************************************
+//
+//	Copyright (C) 2009 Texas Instruments Incorporated - http://www.ti.com/ 
+//	 
+//	 
+//	  Redistribution and use in source and binary forms, with or without 
+//	  modification, are permitted provided that the following conditions 
+//	  are met:
+//	
+//	    Redistributions of source code must retain the above copyright 
+//	    notice, this list of conditions and the following disclaimer.
+//	 
+//	    Redistributions in binary form must reproduce the above copyright
+//	    notice, this list of conditions and the following disclaimer in the 
+//	    documentation and/or other materials provided with the   
+//	    distribution.
+//	 
+//	    Neither the name of Texas Instruments Incorporated nor the names of
+//	    its contributors may be used to endorse or promote products derived
+//	    from this software without specific prior written permission.
+//	
+//	  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+//	  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+//	  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+//	  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+//	  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+//	  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+//	  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//	  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+//	  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+//	  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+//	  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *************************************************************************************************
+
+#ifndef EVENT_H_
+#define EVENT_H_
+
+// *************************************************************************************************
+// Include section
+
+
+// *************************************************************************************************
+// Prototypes section
+struct event;
+extern u8 post_event(u8 type, u16 payload);
+extern u8 get_event(struct event * event);
+extern u8 is_event_pending(void);
+
+
+// *************************************************************************************************
+// Defines section
+
+// Number of events the ring holds (power of 2)
+#define EVENT_RING_SIZE			(16u)
+
+// Event types and their payload
+#define EVENT_TEMPERATURE		(0u)	// Measure temperature (1/s while menu item is visible)
+#define EVENT_VOLTAGE			(1u)	// Measure battery voltage (1/min)
+#define EVENT_PRESSURE			(2u)	// Pressure sensor DRDY, payload 1 = found by pin check
+#define EVENT_ACCELERATION		(3u)	// Sample batch complete, payload = sample ring write index
+#define EVENT_FREE_FALL			(4u)	// Acceleration sensor free fall INT
+#define EVENT_BUZZER			(5u)	// Output alarm signal
+#define EVENT_TYPES				(6u)
+
+
+// *************************************************************************************************
+// Global Variable section
+struct event
+{
+	// EVENT_xxx
+	u8		type;
+	u16		payload;
+	
+	// TA0R when the event was posted
+	u16		time;
+};
+
+// Single producer / single consumer ring. ISRs do not nest, so all ISRs together are the single
+// producer, the main loop is the consumer. Each index is only written by its own side.
+struct events
+{
+	struct event ring[EVENT_RING_SIZE];
+	
+	// Only changed by ISRs
+	volatile u8	write;
+	
+	// Only changed by main loop
+	volatile u8	read;
+
+	// Events dropped because the ring was full, per type (saturating)
+	u16		overflow[EVENT_TYPES];
+
+	// Highest number of events waiting in the ring
+	u8		max_fill;
+};
+extern struct events sEvents;
+
+
+// *************************************************************************************************
+// Extern section
+
+
+#endif /*EVENT_H_*/
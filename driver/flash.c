@@ -0,0 +1,177 @@
+// *************************************************************************************************
+//
+//	Copyright (C) 2009 Texas Instruments Incorporated - http://www.ti.com/ 
+//	 
+//	 
+//	  Redistribution and use in source and binary forms, with or without 
+//	  modification, are permitted provided that the following conditions 
+//	  are met:
+//	
+//	    Redistributions of source code must retain the above copyright 
+//	    notice, this list of conditions and the following disclaimer.
+//	 
+//	    Redistributions in binary form must reproduce the above copyright
+//	    notice, this list of conditions and the following disclaimer in the 
+//	    documentation and/or other materials provided with the   
+//	    distribution.
+//	 
+//	    Neither the name of Texas Instruments Incorporated nor the names of
+//	    its contributors may be used to endorse or promote products derived
+//	    from this software without specific prior written permission.
+//	
+//	  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+//	  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+//	  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+//	  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+//	  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+//	  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+//	  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//	  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+//	  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+//	  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+//	  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *************************************************************************************************
+
+// Flash controller access for data kept across resets. Code runs from flash, so the CPU is held
+// while the flash controller erases or programs, and interrupts are serviced afterwards. 
+// Acceleration samples that the DRDY interrupt could not fetch in that time are counted.
+// *************************************************************************************************
+
+
+// *************************************************************************************************
+// Include section
+
+// system
+#include "project.h"
+
+// driver
+#include "flash.h"
+#include "vti_as.h"
+
+
+// *************************************************************************************************
+// Prototypes section
+void flash_erase_segment(u16 address);
+void flash_write(u16 address, const u8 * data, u16 length);
+u8 flash_is_erased(u16 address, u16 length);
+void flash_count_overrun(u16 start);
+
+
+// *************************************************************************************************
+// Defines section
+
+
+// *************************************************************************************************
+// Global Variable section
+
+// Acceleration samples lost while the CPU was held by a flash operation (saturating)
+u16 flash_sample_overrun;
+
+
+// *************************************************************************************************
+// Extern section
+
+
+// *************************************************************************************************
+// @fn          flash_erase_segment
+// @brief       Erases the flash segment holding the address (all bytes read 0xFF afterwards).
+//				Takes up to 32 ms. The interrupt state of the caller is kept.
+// @param       u16 address		Any address within the segment
+// @return      none
+// *************************************************************************************************
+void flash_erase_segment(u16 address)
+{
+	u16 state;
+	u16 start;
+	
+	state = __get_interrupt_state();
+	__disable_interrupt();
+	start = TA0R;
+
+	FCTL3 = FWKEY;						// Clear LOCK
+	FCTL1 = FWKEY + ERASE;				// Segment erase
+	*(u8 *)address = 0;					// Dummy write starts erase
+	FCTL1 = FWKEY;						// Clear ERASE
+	FCTL3 = FWKEY + LOCK;				// Set LOCK
+
+	flash_count_overrun(start);
+	__set_interrupt_state(state);
+}
+
+
+// *************************************************************************************************
+// @fn          flash_write
+// @brief       Programs bytes into erased flash. Takes around 85 us per byte. The interrupt state
+//				of the caller is kept.
+// @param       u16 address			Destination address
+//				const u8 * data		Source data
+//				u16 length			Number of bytes
+// @return      none
+// *************************************************************************************************
+void flash_write(u16 address, const u8 * data, u16 length)
+{
+	u8 * dest = (u8 *)address;
+	u16 state;
+	u16 start;
+
+	state = __get_interrupt_state();
+	__disable_interrupt();
+	start = TA0R;
+
+	FCTL3 = FWKEY;						// Clear LOCK
+	FCTL1 = FWKEY + WRT;				// Byte write
+	while (length-- > 0)
+	{
+		*dest++ = *data++;
+	}
+	FCTL1 = FWKEY;						// Clear WRT
+	FCTL3 = FWKEY + LOCK;				// Set LOCK
+
+	flash_count_overrun(start);
+	__set_interrupt_state(state);
+}
+
+
+// *************************************************************************************************
+// @fn          flash_is_erased
+// @brief       Checks if a flash area is erased.
+// @param       u16 address		Start address
+//				u16 length		Number of bytes
+// @return      u8				1 = all bytes are 0xFF
+// *************************************************************************************************
+u8 flash_is_erased(u16 address, u16 length)
+{
+	const u8 * src = (const u8 *)address;
+
+	while (length-- > 0)
+	{
+		if (*src++ != 0xFF) return (0);
+	}
+	return (1);
+}
+
+
+// *************************************************************************************************
+// @fn          flash_count_overrun
+// @brief       Count the acceleration samples lost during a flash operation. The sensor holds
+//				DRDY high until a sample is read, so of the samples output while the CPU was held
+//				only the newest is read (late), the others are lost.
+// @param       u16 start		TA0R when the flash operation started
+// @return      none
+// *************************************************************************************************
+void flash_count_overrun(u16 start)
+{
+	u32 periods;
+	
+	// DRDY is only serviced while the sensor samples in measurement mode
+	if (!(AS_INT_IE & AS_INT_PIN) || (as_mode != AS_MODE_MEASUREMENT)) return;
+	
+	// Sample periods elapsed, TA0R counts ACLK (32768 Hz)
+	periods = ((u32)(u16)(TA0R - start) * as_rate) >> 15;
+	if (periods < 2) return;
+	
+	periods += flash_sample_overrun - 1;
+	if (periods > 0xFFFF)	flash_sample_overrun = 0xFFFF;
+	else					flash_sample_overrun = (u16)periods;
+}
@@ -48,6 +48,7 @@
 #include "vti_as.h"
 #include "vti_ps.h"
 #include "timer.h"
+#include "event.h"
 #include "display.h"
 
 // logic
@@ -64,6 +65,11 @@
 void button_repeat_on(u16 msec);
 void button_repeat_off(void);
 void button_repeat_function(void);
+void start_button_debounce(u8 pins);
+void button_debounce_in(void);
+void button_debounce_out(void);
+void button_debounce_left(void);
+void end_button_debounce(void);
 
 
 // *************************************************************************************************
@@ -78,10 +84,16 @@ void button_repeat_function(void);
 volatile s_button_flags button;
 volatile struct struct_button sButton;
 
+// Button auto repeat timer
+struct soft_timer button_repeat_timer;
+
+// Button debounce timer and STAR/NUM events held back until the long press check is done
+struct soft_timer button_debounce_timer;
+s_button_flags button_event;
+
 
 // *************************************************************************************************
 // Extern section
-extern void (*fptr_Timer0_A3_function)(void);
 
 
 // *************************************************************************************************
@@ -118,32 +130,58 @@ void init_buttons(void)
 //					- buttons 
 //					- acceleration sensor CMA_INT 
 //					- pressure sensor DRDY
+//				Button edges only start the debounce timer, so the ISR never waits and the
+//				sensor interrupts stay enabled while a button is debounced.
 // @param       none
 // @return      none
 // *************************************************************************************************
 #pragma vector=PORT2_VECTOR
 __interrupt void PORT2_ISR(void)
 {
-	u8 int_flag, int_enable;
-	u8 buzzer = 0;
+	u8 int_flag;
+	u8 wakeup = 0;
 	u8 simpliciti_button_event = 0;
 	static u8 simpliciti_button_repeat = 0;
 
-	// Clear button flags
-	button.all_flags = 0;
+	// Store valid interrupt flags and reset them, edges arriving from now on are kept
+	int_flag = BUTTONS_IFG & BUTTONS_IE;
+	BUTTONS_IFG &= ~int_flag;
+
+#ifdef USE_DRDY_LATENCY_PROBE
+	if ((int_flag & (AS_INT_PIN + PS_INT_PIN)) != 0) DRDY_PROBE_OUT |= DRDY_PROBE_PIN;
+#endif
 
-	// Remember interrupt enable bits
-	int_enable = BUTTONS_IE;
+	// ---------------------------------------------------
+	// Acceleration sensor IRQ
+	if (IRQ_TRIGGERED(int_flag, AS_INT_PIN))
+	{
+		// Get data from sensor, sample is read in background by DMA
+		// Main loop need not wake up if no other source triggered
+		if (as_int_event()) wakeup = 1;
+  	}
+  	
+  	// ---------------------------------------------------
+	// Pressure sensor IRQ
+	if (IRQ_TRIGGERED(int_flag, PS_INT_PIN)) 
+	{
+		// Get data from sensor
+		post_event(EVENT_PRESSURE, 0);
+		wakeup = 1;
+  	}
 
-	// Store valid button interrupt flag
-	int_flag = BUTTONS_IFG & int_enable;
+#ifdef USE_DRDY_LATENCY_PROBE
+	DRDY_PROBE_OUT &= ~DRDY_PROBE_PIN;
+#endif
 
 	// ---------------------------------------------------
 	// While SimpliciTI stack is active, buttons behave differently:
 	//  - Store button events in SimpliciTI packet data
 	//  - Exit SimpliciTI when button DOWN was pressed 
-  	if (is_rf())
+  	if (is_rf() && ((int_flag & ALL_BUTTONS) != 0))
   	{
+		// Clear button flags
+		button.all_flags = 0;
+		
   		// Erase previous button press after a number of resends (increase number if link quality is low)
   		// This will create a series of packets containing the same button press
   		// Necessary because we have no acknowledge
@@ -176,103 +214,126 @@ __interrupt void PORT2_ISR(void)
 		
 		// Trigger packet sending inside SimpliciTI stack
 		if (simpliciti_button_event) simpliciti_flag |= SIMPLICITI_TRIGGER_SEND_DATA;
+		
+		wakeup = 1;
   	}
-  	else // Normal operation
+  	else if ((int_flag & ALL_BUTTONS) != 0) // Normal operation
   	{
-		// Debounce buttons
-		if ((int_flag & ALL_BUTTONS) != 0)
-		{ 
-			// Disable PORT2 IRQ
-			__disable_interrupt();
-			BUTTONS_IE = 0x00; 
-			__enable_interrupt();
+		// Button is sampled again by the debounce timer
+		start_button_debounce(int_flag & ALL_BUTTONS);
+	}
+
+	// Exit from LPM3/LPM4 on RETI
+	if (wakeup) __bic_SR_register_on_exit(LPM4_bits); 
+}
+
+
+// *************************************************************************************************
+// @fn          start_button_debounce
+// @brief       Disable button IRQs and sample the buttons again after BUTTONS_DEBOUNCE_TIME_IN.
+//				The debounce runs in stages on button_debounce_timer:
+//					IN		Check which button is pressed, generate event and button click
+//					OUT		Wait until the button bounce on release is over
+//					LEFT	STAR/NUM only: discard event if the button is still held (long press)
+// @param       u8 pins			Button pins that triggered
+// @return      none
+// *************************************************************************************************
+void start_button_debounce(u8 pins)
+{
+	// Disable button IRQs, sensor IRQs stay enabled
+	sButton.debounce_enable = BUTTONS_IE & ALL_BUTTONS;
+	BUTTONS_IE &= ~ALL_BUTTONS;
+	sButton.debounce_pins = pins;
 	
-			// Debounce delay 1
-			Timer0_A4_Delay(CONV_MS_TO_TICKS(BUTTONS_DEBOUNCE_TIME_IN));
+	// Reset inactivity detection
+	sTime.last_activity = sTime.system_time;
 	
-			// Reset inactivity detection
-			sTime.last_activity = sTime.system_time;
-		}
+	start_soft_timer(&button_debounce_timer, CONV_MS_TO_TICKS(BUTTONS_DEBOUNCE_TIME_IN), 0, button_debounce_in);
+}
 
-		// ---------------------------------------------------
-		// STAR button IRQ
-		if (IRQ_TRIGGERED(int_flag, BUTTON_STAR_PIN))
-		{
-			// Filter bouncing noise 
-			if (BUTTON_STAR_IS_PRESSED)
-			{
-				button.flag.star = 1;
-				
-				// Generate button click
-				buzzer = 1;
-			}
-		}
-		// ---------------------------------------------------
-		// NUM button IRQ
-		else if (IRQ_TRIGGERED(int_flag, BUTTON_NUM_PIN))
-		{
-			// Filter bouncing noise 
-			if (BUTTON_NUM_IS_PRESSED)
-			{
-				button.flag.num = 1;
+
+// *************************************************************************************************
+// @fn          button_debounce_in
+// @brief       Debounce stage IN. Generate event of the button that triggered if it is still 
+//				pressed. UP, DOWN and BACKLIGHT events go to the main loop at once.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void button_debounce_in(void)
+{
+	u8 buzzer = 0;
 	
-				// Generate button click
-				buzzer = 1;
-			}
+	button_event.all_flags = 0;
+	
+	// ---------------------------------------------------
+	// STAR button IRQ
+	if (IRQ_TRIGGERED(sButton.debounce_pins, BUTTON_STAR_PIN))
+	{
+		// Filter bouncing noise 
+		if (BUTTON_STAR_IS_PRESSED)
+		{
+			button_event.flag.star = 1;
+			
+			// Generate button click
+			buzzer = 1;
 		}
-		// ---------------------------------------------------
-		// UP button IRQ
-		else if (IRQ_TRIGGERED(int_flag, BUTTON_UP_PIN))
+	}
+	// ---------------------------------------------------
+	// NUM button IRQ
+	else if (IRQ_TRIGGERED(sButton.debounce_pins, BUTTON_NUM_PIN))
+	{
+		// Filter bouncing noise 
+		if (BUTTON_NUM_IS_PRESSED)
 		{
-			// Filter bouncing noise 
-			if (BUTTON_UP_IS_PRESSED)
-			{
-				button.flag.up = 1;
-		
-				// Generate button click
-				buzzer = 1;
-			}
+			button_event.flag.num = 1;
+
+			// Generate button click
+			buzzer = 1;
 		}
-		// ---------------------------------------------------
-		// DOWN button IRQ
-		else if (IRQ_TRIGGERED(int_flag, BUTTON_DOWN_PIN))
+	}
+	// ---------------------------------------------------
+	// UP button IRQ
+	else if (IRQ_TRIGGERED(sButton.debounce_pins, BUTTON_UP_PIN))
+	{
+		// Filter bouncing noise 
+		if (BUTTON_UP_IS_PRESSED)
 		{
-			// Filter bouncing noise 
-			if (BUTTON_DOWN_IS_PRESSED)
-			{
-				button.flag.down = 1;
+			button_event.flag.up = 1;
 	
-				// Generate button click
-				buzzer = 1;
-				
-				// Faster reaction for stopwatch stop button press
-				if (is_stopwatch() && !sys.flag.lock_buttons) 
-				{
-					stop_stopwatch();
-					button.flag.down = 0;
-				}
-					
-			}
+			// Generate button click
+			buzzer = 1;
 		}
-		// ---------------------------------------------------
-		// B/L button IRQ
-		else if (IRQ_TRIGGERED(int_flag, BUTTON_BACKLIGHT_PIN))
+	}
+	// ---------------------------------------------------
+	// DOWN button IRQ
+	else if (IRQ_TRIGGERED(sButton.debounce_pins, BUTTON_DOWN_PIN))
+	{
+		// Filter bouncing noise 
+		if (BUTTON_DOWN_IS_PRESSED)
 		{
-			// Filter bouncing noise 
-			if (BUTTON_BACKLIGHT_IS_PRESSED)
+			button_event.flag.down = 1;
+
+			// Generate button click
+			buzzer = 1;
+			
+			// Faster reaction for stopwatch stop button press
+			if (is_stopwatch() && !sys.flag.lock_buttons) 
 			{
-				button.flag.backlight = 1;
+				stop_stopwatch();
+				button_event.flag.down = 0;
 			}
-		}	
+		}
 	}
-	
-	// Trying to lock/unlock buttons?
-	if (button.flag.num && button.flag.down)
+	// ---------------------------------------------------
+	// B/L button IRQ
+	else if (IRQ_TRIGGERED(sButton.debounce_pins, BUTTON_BACKLIGHT_PIN))
 	{
-		// No buzzer output
-		buzzer = 0;
-		button.all_flags = 0;
-	}
+		// Filter bouncing noise 
+		if (BUTTON_BACKLIGHT_IS_PRESSED)
+		{
+			button_event.flag.backlight = 1;
+		}
+	}	
 
 	// Generate button click when button was activated
 	if (buzzer)
@@ -281,53 +342,85 @@ __interrupt void PORT2_ISR(void)
 		if (sAlarm.state == ALARM_ON) 
 		{
 			stop_alarm();
-			button.all_flags = 0;
+			button_event.all_flags = 0;
 		}
+#ifndef USE_DRDY_LATENCY_PROBE
 		else if (!sys.flag.up_down_repeat_enabled)
 		{
 			start_buzzer(1, CONV_MS_TO_TICKS(20), CONV_MS_TO_TICKS(150));
 		}
-		
-		// Debounce delay 2
-		Timer0_A4_Delay(CONV_MS_TO_TICKS(BUTTONS_DEBOUNCE_TIME_OUT));
+#endif
 	}
 	
-	// ---------------------------------------------------
-	// Acceleration sensor IRQ
-	if (IRQ_TRIGGERED(int_flag, AS_INT_PIN))
+	// Hand over events that need no long press check
+	if (button_event.flag.up || button_event.flag.down || button_event.flag.backlight)
 	{
-		// Get data from sensor
-		request.flag.acceleration_measurement = 1;
-  	}
-  	
-  	// ---------------------------------------------------
-	// Pressure sensor IRQ
-	if (IRQ_TRIGGERED(int_flag, PS_INT_PIN)) 
+		button.all_flags = button_event.all_flags;
+		button_event.all_flags = 0;
+	}
+
+	if (buzzer)
 	{
-		// Get data from sensor
-		request.flag.altitude_measurement = 1;
-  	}
-  	
-  	// ---------------------------------------------------
+		// Debounce delay 2
+		start_soft_timer(&button_debounce_timer, CONV_MS_TO_TICKS(BUTTONS_DEBOUNCE_TIME_OUT), 0, button_debounce_out);
+	}
+	else
+	{
+		end_button_debounce();
+	}
+}
+
+
+// *************************************************************************************************
+// @fn          button_debounce_out
+// @brief       Debounce stage OUT. Start the long press check for STAR/NUM events.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void button_debounce_out(void)
+{
   	// Safe long button event detection
-  	if(button.flag.star || button.flag.num) 
+	if (button_event.flag.star || button_event.flag.num) 
 	{
 		// Additional debounce delay to enable safe high detection
-		Timer0_A4_Delay(CONV_MS_TO_TICKS(BUTTONS_DEBOUNCE_TIME_LEFT));
-	
-		// Check if this button event is short enough
-		if (BUTTON_STAR_IS_PRESSED) button.flag.star = 0;
-		if (BUTTON_NUM_IS_PRESSED) button.flag.num = 0;	
+		start_soft_timer(&button_debounce_timer, CONV_MS_TO_TICKS(BUTTONS_DEBOUNCE_TIME_LEFT), 0, button_debounce_left);
+	}
+	else
+	{
+		end_button_debounce();
 	}
+}
+
+
+// *************************************************************************************************
+// @fn          button_debounce_left
+// @brief       Debounce stage LEFT. Hand over STAR/NUM event if the button was released.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void button_debounce_left(void)
+{
+	// Check if this button event is short enough
+	if (BUTTON_STAR_IS_PRESSED) button_event.flag.star = 0;
+	if (BUTTON_NUM_IS_PRESSED) button_event.flag.num = 0;	
+	
+	if (button_event.all_flags != 0) button.all_flags = button_event.all_flags;
+	button_event.all_flags = 0;
 	
-	// Reenable PORT2 IRQ
-	__disable_interrupt();
-	BUTTONS_IFG = 0x00; 	
-	BUTTONS_IE  = int_enable; 	
-	__enable_interrupt();
+	end_button_debounce();
+}
 
-	// Exit from LPM3/LPM4 on RETI
-	__bic_SR_register_on_exit(LPM4_bits); 
+
+// *************************************************************************************************
+// @fn          end_button_debounce
+// @brief       Reenable button IRQs.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void end_button_debounce(void)
+{
+	BUTTONS_IFG &= ~ALL_BUTTONS; 	
+	BUTTONS_IE  |= sButton.debounce_enable; 	
 }
 
 
@@ -342,11 +435,8 @@ void button_repeat_on(u16 msec)
 	// Set button repeat flag
 	sys.flag.up_down_repeat_enabled = 1;
 	
-	// Set Timer0_A3 function pointer to button repeat function
-	fptr_Timer0_A3_function = button_repeat_function;
-	
-	// Timer0_A3 IRQ triggers every 200ms
-	Timer0_A3_Start(CONV_MS_TO_TICKS(msec));
+	// Call button repeat function every "msec" milliseconds
+	start_soft_timer(&button_repeat_timer, CONV_MS_TO_TICKS(msec), CONV_MS_TO_TICKS(msec), button_repeat_function);
 }
 
 
@@ -361,8 +451,8 @@ void button_repeat_off(void)
 	// Clear button repeat flag
 	sys.flag.up_down_repeat_enabled = 0;
 	
-	// Timer0_A3 IRQ repeats with 4Hz
-	Timer0_A3_Stop();
+	// Stop button repeat timer
+	stop_soft_timer(&button_repeat_timer);
 }
 
 
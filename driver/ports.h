@@ -72,6 +72,22 @@
 #define BUTTON_DOWN_IS_RELEASED			((BUTTONS_IN & BUTTON_DOWN_PIN) == 0)
 #define BUTTON_BACKLIGHT_IS_RELEASED	((BUTTONS_IN & BUTTON_BACKLIGHT_PIN) == 0)
 
+#ifdef USE_DRDY_LATENCY_PROBE
+// DRDY latency probe on P2.7 (buzzer output). The pin is a GPIO output while the buzzer is off,
+// so the button click is disabled in a probe build.
+//
+// Measurement: channel 1 on the acceleration sensor INT pin (P2.5), channel 2 on P2.7, trigger on
+// the rising INT edge, infinite persistence, 400 Hz measurement mode, all buttons hammered with
+// the stopwatch running. The worst-case latency is the longest delay to the rising probe edge.
+//
+// Expected bound from the code (not yet confirmed on a scope): the CPU is held for up to 32 ms
+// while a flash segment is erased (data log, fall record, SimpliciTI context) and for about 3 ms
+// while a 32 byte fall record chunk is programmed. Without flash access the latency is set by the
+// longest ISR or interrupt-disabled section, which is well below one 2.5 ms sample period.
+#define DRDY_PROBE_OUT			(P2OUT)
+#define DRDY_PROBE_PIN			(BIT7)
+#endif
+
 // Button debounce time (msec)
 #define BUTTONS_DEBOUNCE_TIME_IN	(5u)
 #define BUTTONS_DEBOUNCE_TIME_OUT	(250u)
@@ -107,6 +123,10 @@ struct struct_button
 	u8  star_timeout;		 
 	u8  num_timeout;		 
 	s16 repeats;			
+	
+	// Button pins being debounced and button IRQ enable bits to restore afterwards
+	u8  debounce_pins;
+	u8  debounce_enable;
 };
 extern volatile struct struct_button sButton;
 
@@ -0,0 +1,218 @@
+// *************************************************************************************************
+//
+//	Copyright (C) 2009 Texas Instruments Incorporated - http://www.ti.com/ 
+//	 
+//	 
+//	  Redistribution and use in source and binary forms, with or without 
+//	  modification, are permitted provided that the following conditions 
+//	  are met:
+//	
+//	    Redistributions of source code must retain the above copyright 
+//	    notice, this list of conditions and the following disclaimer.
+//	 
+//	    Redistributions in binary form must reproduce the above copyright
+//	    notice, this list of conditions and the following disclaimer in the 
+//	    documentation and/or other materials provided with the   
+//	    distribution.
+//	 
+//	    Neither the name of Texas Instruments Incorporated nor the names of
+//	    its contributors may be used to endorse or promote products derived
+//	    from this software without specific prior written permission.
+//	
+//	  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+//	  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+//	  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+//	  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+//	  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+//	  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+//	  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+//	  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+//	  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+//	  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+//	  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *************************************************************************************************
+// Pressure to altitude conversion of the VTI SCP1000-D0x pressure sensor in fixed point. Free of
+// hardware access, so host/pressure_test.c can check it against the VTI floating point reference.
+// *************************************************************************************************
+
+
+// *************************************************************************************************
+// Include section
+
+// system
+#include "project.h"
+
+// driver
+#include "vti_ps.h"
+
+
+// *************************************************************************************************
+// Prototypes section
+u32 mul_q16(u32 a, u32 b);
+void update_pressure_slopes(void);
+
+
+// *************************************************************************************************
+// Defines section
+
+
+// *************************************************************************************************
+// Global Variable section
+
+// VTI pressure (hPa) to altitude (m) conversion tables
+const s16 h0[17] = { -153, 0, 111, 540, 989, 1457, 1949, 2466, 3012, 3591, 4206, 4865, 5574, 6344, 7185, 8117, 9164 };
+const u16 p0[17] = { 1031, 1013, 1000, 950, 900, 850, 800, 750, 700, 650, 600, 550, 500, 450, 400, 350, 300 };
+
+// Pressure table (Pa) for the current reference and the height (1/16m) per Pa of each interval (Q16)
+u32 p[17];
+u32 p_slope[17];
+
+
+// *************************************************************************************************
+// Extern section
+
+
+
+// *************************************************************************************************
+// @fn          mul_q16
+// @brief       Multiply two unsigned values and drop 16 fractional bits. Uses 16x16 bit products
+//				only, so the hardware multiplier does all the work.
+// @param       u32		a		Factor
+//				u32		b		Factor (Q16)
+// @return      u32				(a*b) >> 16, rounded
+// *************************************************************************************************
+u32 mul_q16(u32 a, u32 b)
+{
+	u16 ah = a >> 16, al = a;
+	u16 bh = b >> 16, bl = b;
+
+	return ((((u32)ah * bh) << 16) + (u32)ah * bl + (u32)al * bh + (((u32)al * bl + 0x8000) >> 16));
+}
+
+
+// *************************************************************************************************
+// @fn          update_pressure_slopes
+// @brief       Calculate the inverse slope of each pressure table interval.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void update_pressure_slopes(void)
+{
+	u8 i;
+
+	// Height (1/16m) per Pa in Q16 format
+	for (i=1; i<17; i++)
+	{
+		p_slope[i] = ((u32)(h0[i] - h0[i-1]) << 20) / (p[i-1] - p[i]);
+	}
+}
+
+
+// *************************************************************************************************
+// @fn          init_pressure_table
+// @brief       Init pressure table with constants
+// @param       none
+// @return      none
+// *************************************************************************************************
+void init_pressure_table(void)
+{
+	u8 i;
+
+	for (i=0; i<17; i++) p[i] = (u32)p0[i] * 100;
+	update_pressure_slopes();
+}
+
+
+// *************************************************************************************************
+// @fn          update_pressure_table
+// @brief       Calculate pressure table for reference altitude.
+//				Implemented from VTI reference code in fixed point. Heights are in 1/16m.
+// @param       s16		href	Reference height
+//				u32		p_meas	Pressure (Pa)
+//				u16		t_meas	Temperature (10*K)
+// @return     	none
+// *************************************************************************************************
+void update_pressure_table(s16 href, u32 p_meas, u16 t_meas)
+{
+	s32 t0, hnoll, a, dh, q, r;
+	u32 p_noll, c, product;
+	u8 i;
+
+	// Temperature at sea level (1/16 of 0.1K): t0 = t_meas + 0.0065K/m * href
+	t0 = (s32)t_meas * 16 + ((s32)href * 104) / 100;
+
+	// Height in standard atmosphere: hnoll = href * 288.15K / t0
+	q = ((s32)href * 46104) / t0;
+	r = ((s32)href * 46104) % t0;
+	hnoll = q * 16 + (r * 16) / t0;
+
+	for (i=1; i<16; i++)
+	{
+		if ((s32)h0[i] * 16 > hnoll) break;
+	}
+
+	// Interpolate in interval i, curvature is 1 - (hnoll - h0[i]) * 0.00006/m
+	a  = hnoll - (s32)h0[i-1] * 16;
+	dh = (s32)h0[i] * 16 - hnoll;
+	if (dh >= 0)	c = 65536 + mul_q16(dh, 16106);
+	else			c = 65536 - mul_q16(-dh, 16106);
+	if (a >= 0)		a =  (s32)mul_q16(a, c);
+	else			a = -(s32)mul_q16(-a, c);
+	p_noll = (s32)p0[i-1] * 100 - (a * (p0[i-1] - p0[i]) * 100) / ((h0[i] - h0[i-1]) * 16);
+
+	// Apply correction factor p_meas/p_noll to pressure table
+	for (i=0; i<17; i++)
+	{
+		product = (u32)p0[i] * p_meas;
+		p[i] = (product / p_noll) * 100 + ((product % p_noll) * 100 + p_noll / 2) / p_noll;
+	}
+	update_pressure_slopes();
+}
+
+
+// *************************************************************************************************
+// @fn          conv_pa_to_meter
+// @brief       Convert pressure (Pa) to altitude (m) using a conversion table
+//				Implemented from VTI reference code in fixed point. Heights are in 1/16m.
+// @param       u32		p_meas	Pressure (Pa)
+//				u16		t_meas	Temperature (10*K)
+// @return      s16				Altitude (m)
+// *************************************************************************************************
+s16 conv_pa_to_meter(u32 p_meas, u16 t_meas)
+{
+	s32 u, hnoll, h;
+	u32 c, t0;
+	u8 i, k;
+
+	for (i=0; i<=16; i++)
+	{
+		if (p[i] < p_meas) break;
+	}
+
+	// Pressure below table end or above table start is extrapolated from the outer interval
+	k = i;
+	if (k == 0) k = 1;
+	if (k > 16) k = 16;
+	u = (s32)p[k-1] - (s32)p_meas;
+
+	// Curvature inside the table is 1 - (p_meas - p[i]) * 0.0007/hPa
+	if ((i >= 1) && (i < 15))
+	{
+		c = 65536 - mul_q16(p_meas - p[i], 30065);
+		u = mul_q16(u, c);
+	}
+
+	if (u >= 0)	hnoll = (s32)h0[k-1] * 16 + (s32)mul_q16(u, p_slope[k]);
+	else		hnoll = (s32)h0[k-1] * 16 - (s32)mul_q16(-u, p_slope[k]);
+
+	// Compensate temperature error: h = hnoll * t_meas / (288.15K - 0.0065K/m * hnoll)
+	if (hnoll >= 0)	t0 = 46104 - mul_q16(hnoll, 4260);
+	else			t0 = 46104 + mul_q16(-hnoll, 4260);
+	c = (((u32)t_meas << 20) + (t0 >> 1)) / t0;
+
+	if (hnoll >= 0)	h =  (s32)((mul_q16(hnoll, c) + 8) >> 4);
+	else			h = -(s32)((mul_q16(-hnoll, c) + 8) >> 4);
+
+	return ((s16)h);
+}
@@ -44,6 +44,7 @@
 
 // driver
 #include "timer.h"
+#include "event.h"
 #include "ports.h"
 #include "buzzer.h"
 #include "vti_ps.h"
@@ -60,6 +61,7 @@
 #include "rfsimpliciti.h"
 #include "simpliciti.h"
 #include "fall_detection.h"
+#include "fall_height.h"
 #ifdef USE_BLUEROBIN
 #include "bluerobin.h"
 #endif //USE_BLUEROBIN
@@ -72,10 +74,13 @@ void Timer0_Init(void);
 void Timer0_Stop(void);
 void Timer0_A1_Start(void);
 void Timer0_A1_Stop(void);
-void Timer0_A3_Start(u16 ticks);
-void Timer0_A3_Stop(void);
+void start_soft_timer(struct soft_timer * timer, u16 ticks, u16 period, void (*callback)(void));
+void stop_soft_timer(struct soft_timer * timer);
+u8 is_soft_timer(struct soft_timer * timer);
+void insert_soft_timer(struct soft_timer * timer);
+void remove_soft_timer(struct soft_timer * timer);
+void program_soft_timer(void);
 void Timer0_A4_Delay(u16 ticks);
-void (*fptr_Timer0_A3_function)(void);
  
 
 // *************************************************************************************************
@@ -89,7 +94,6 @@ struct timer sTimer;
 // *************************************************************************************************
 // Extern section
 extern void BRRX_TimerTask_v(void);
-extern void to_lpm(void);
 
 
 // *************************************************************************************************
@@ -142,82 +146,174 @@ void Timer0_Stop(void)
 
 
 // *************************************************************************************************
-// @fn          Timer0_A3_Start
-// @brief       Trigger IRQ every "ticks" microseconds
-// @param       ticks (1 tick = 1/32768 sec)
+// @fn          start_soft_timer
+// @brief       Start a software timer. A running timer is restarted. Software timers share 
+//				Timer0_A3, its CCR always holds the nearest deadline.
+// @param       struct soft_timer * timer		Timer, must stay valid while it runs
+//				u16 ticks						First expiry after "ticks" (1 tick = 1/32768 sec)
+//				u16 period						Period in ticks, 0 = one-shot timer
+//				void (*callback)(void)			Called in ISR context on expiry, may be 0
 // @return      none
 // *************************************************************************************************
-void Timer0_A3_Start(u16 ticks)
+void start_soft_timer(struct soft_timer * timer, u16 ticks, u16 period, void (*callback)(void))
 {
-	u16 value;
+	u16 state;
 	
-	// Store timer ticks in global variable
-	sTimer.timer0_A3_ticks = ticks;
+	state = __get_interrupt_state();
+	__disable_interrupt();
 	
-	// Delay based on current counter value
-	value = TA0R + ticks;
+	if (timer->active) remove_soft_timer(timer);
 	
-	// Update CCR
-	TA0CCR3 = value;   
+	timer->deadline = TA0R + ticks;
+	timer->period   = period;
+	timer->callback = callback;
+	timer->active   = 1;
+	insert_soft_timer(timer);
+	program_soft_timer();
+	
+	__set_interrupt_state(state);
+}
 
-	// Reset IRQ flag    
-	TA0CCTL3 &= ~CCIFG; 
-	          
-	// Enable timer interrupt    
-	TA0CCTL3 |= CCIE; 
+
+// *************************************************************************************************
+// @fn          stop_soft_timer
+// @brief       Stop a software timer. Stopping a timer that is not running is allowed.
+// @param       struct soft_timer * timer		Timer
+// @return      none
+// *************************************************************************************************
+void stop_soft_timer(struct soft_timer * timer)
+{
+	u16 state;
+	
+	state = __get_interrupt_state();
+	__disable_interrupt();
+	
+	if (timer->active) 
+	{
+		remove_soft_timer(timer);
+		timer->active = 0;
+		program_soft_timer();
+	}
+	
+	__set_interrupt_state(state);
 }
 
 
+// *************************************************************************************************
+// @fn          is_soft_timer
+// @brief       Returns 1 while a software timer runs. One-shot timers stop on expiry.
+// @param       struct soft_timer * timer		Timer
+// @return      u8
+// *************************************************************************************************
+u8 is_soft_timer(struct soft_timer * timer)
+{
+	return (timer->active);
+}
 
+
+// *************************************************************************************************
+// @fn          insert_soft_timer
+// @brief       Insert a timer into the deadline list. Timers with the same deadline expire in 
+//				start order. Call with interrupts disabled.
+// @param       struct soft_timer * timer		Timer
+// @return      none
 // *************************************************************************************************
-// @fn          Timer0_A3_Stop
-// @brief       Stop Timer0_A3.
+void insert_soft_timer(struct soft_timer * timer)
+{
+	struct soft_timer ** link = &sTimer.head;
+	
+	// All deadlines are less than half the Timer0 range ahead, so the difference orders them
+	while ((*link != 0) && ((s16)((*link)->deadline - timer->deadline) <= 0)) 
+	{
+		link = &(*link)->next;
+	}
+	timer->next = *link;
+	*link = timer;
+}
+
+
+// *************************************************************************************************
+// @fn          remove_soft_timer
+// @brief       Remove a timer from the deadline list. Call with interrupts disabled.
+// @param       struct soft_timer * timer		Timer
+// @return      none
+// *************************************************************************************************
+void remove_soft_timer(struct soft_timer * timer)
+{
+	struct soft_timer ** link = &sTimer.head;
+	
+	while (*link != 0) 
+	{
+		if (*link == timer)
+		{
+			*link = timer->next;
+			break;
+		}
+		link = &(*link)->next;
+	}
+}
+
+
+// *************************************************************************************************
+// @fn          program_soft_timer
+// @brief       Load Timer0_A3 with the nearest deadline, or disable it if no timer runs. 
+//				Call with interrupts disabled.
 // @param       none
 // @return      none
 // *************************************************************************************************
-void Timer0_A3_Stop(void)
+void program_soft_timer(void)
 {
-	// Clear timer interrupt    
-	TA0CCTL3 &= ~CCIE; 
+	if (sTimer.head == 0)
+	{
+		TA0CCTL3 &= ~CCIE;
+		return;
+	}
+	
+	// Update CCR
+	TA0CCR3 = sTimer.head->deadline;
+	
+	// Reset IRQ flag    
+	TA0CCTL3 &= ~CCIFG; 
+	          
+	// Enable timer interrupt    
+	TA0CCTL3 |= CCIE; 
+	
+	// A deadline passed before the CCR was loaded would only match after the next overflow
+	if ((s16)(sTimer.head->deadline - TA0R) <= 0) TA0CCTL3 |= CCIFG;
 }
 
 
 // *************************************************************************************************
 // @fn          Timer0_A4_Delay
-// @brief       Wait for some microseconds
+// @brief       Wait for some microseconds. Runs on a software timer, so delays may nest and run 
+//				while other software timers are active. Interrupts are enabled while waiting,
+//				the caller's interrupt state is restored on return.
 // @param       ticks (1 tick = 1/32768 sec)
 // @return      none
 // *************************************************************************************************
 void Timer0_A4_Delay(u16 ticks)
 {
-	u16 value;
+	struct soft_timer delay;
+	u16 state;
 	
 	// Exit immediately if Timer0 not running - otherwise we'll get stuck here
 	if ((TA0CTL & (BIT4 | BIT5)) == 0) return;    
 
-	// Disable timer interrupt    
-	TA0CCTL4 &= ~CCIE; 	
+	state = __get_interrupt_state();
 
-	// Clear delay_over flag
-	sys.flag.delay_over = 0;
-	
-	// Add delay to current timer value
-	value = TA0R + ticks;
-	
-	// Update CCR
-	TA0CCR4 = value;   
-
-	// Reset IRQ flag    
-	TA0CCTL4 &= ~CCIFG; 
-	          
-	// Enable timer interrupt    
-	TA0CCTL4 |= CCIE; 
+	delay.active = 0;
+	start_soft_timer(&delay, ticks, 0, 0);
 	
 	// Wait for timer IRQ
 	while (1)
 	{
+		// Check stop condition with interrupts disabled, LPM3 entry enables them again
+		__disable_interrupt();
+		if (!is_soft_timer(&delay)) break;
+		
 		// Delay in LPM
-		to_lpm();
+		_BIS_SR(LPM3_bits + GIE); 
+		__no_operation();
 
 #ifdef USE_WATCHDOG		
 		// Service watchdog
@@ -225,10 +321,9 @@ void Timer0_A4_Delay(u16 ticks)
 #endif
 		// Redraw stopwatch display
 		if (is_stopwatch()) display_stopwatch(LINE2, DISPLAY_LINE_UPDATE_PARTIAL);
-
-		// Check stop condition
-		if (sys.flag.delay_over) break;
 	}
+	
+	__set_interrupt_state(state);
 }
 
 
@@ -239,8 +334,7 @@ void Timer0_A4_Delay(u16 ticks)
 //				Timer0_A0	1/1sec clock tick 			(serviced by function TIMER0_A0_ISR)
 //				Timer0_A1	 							(serviced by function TIMER0_A1_5_ISR)
 //				Timer0_A2	1/100 sec Stopwatch			(serviced by function TIMER0_A1_5_ISR)
-//				Timer0_A3	Configurable periodic IRQ	(serviced by function TIMER0_A1_5_ISR)
-//				Timer0_A4	One-time delay				(serviced by function TIMER0_A1_5_ISR)
+//				Timer0_A3	Software timers				(serviced by function TIMER0_A1_5_ISR)
 // @param       none
 // @return      none
 // *************************************************************************************************
@@ -292,7 +386,7 @@ __interrupt void TIMER0_A0_ISR(void)
 	if (sTime.drawFlag >= 2) 
 	{
 		// Measure battery voltage to keep track of remaining battery life
-		request.flag.voltage_measurement = 1;
+		post_event(EVENT_VOLTAGE, 0);
 		
 		// Check if alarm needs to be turned on
 		check_alarm();
@@ -307,7 +401,7 @@ __interrupt void TIMER0_A0_ISR(void)
 		// Decrement alarm duration counter
 		if (sAlarm.duration-- > 0)
 		{
-			request.flag.buzzer = 1;
+			post_event(EVENT_BUZZER, 0);
 		}
 		else
 		{
@@ -317,7 +411,7 @@ __interrupt void TIMER0_A0_ISR(void)
 	}
 
 	// Do a temperature measurement each second while menu item is active
-	if (is_temp_measurement()) request.flag.temperature_measurement = 1;
+	if (is_temp_measurement()) post_event(EVENT_TEMPERATURE, 0);
 	
 	// Do a pressure measurement each second while menu item is active
 	if (is_altitude_measurement()) 
@@ -336,15 +430,24 @@ __interrupt void TIMER0_A0_ISR(void)
 			display_symbol(LCD_SYMB_ARROW_DOWN, SEG_OFF);
 		}
 		
-		// In case we missed the IRQ due to debouncing, get data now
-		if ((PS_INT_IN & PS_INT_PIN) == PS_INT_PIN) request.flag.altitude_measurement = 1;
+		// In case the DRDY edge was missed (sensor restarted, event ring full), get data now. 
+		// A second read of the same sample is skipped because DRDY is low then.
+		if ((PS_INT_IN & PS_INT_PIN) == PS_INT_PIN) post_event(EVENT_PRESSURE, 1);
 	}	
+	else if (is_fall_height_sampling())
+	{
+		// Same for the pressure samples of the fall detector, only while the sensor converts
+		if ((PS_INT_IN & PS_INT_PIN) == PS_INT_PIN) post_event(EVENT_PRESSURE, 1);
+	}
 
 	// Count down timeout
 	if (is_acceleration_measurement()) 
 	{
 		// If DRDY is (still) high, request data again
-		if ((AS_INT_IN & AS_INT_PIN) == AS_INT_PIN) request.flag.acceleration_measurement = 1; 
+		if ((AS_INT_IN & AS_INT_PIN) == AS_INT_PIN) as_int_event(); 
+		
+		// Refresh gravity direction before a hardware free fall trigger
+		if (is_posture_reference_due()) post_event(EVENT_ACCELERATION, 0);
 	}	
 	
 	// If BlueRobin transmitter is connected, get data from API
@@ -452,15 +555,14 @@ __interrupt void TIMER0_A0_ISR(void)
 //				Timer0_A0	1/1sec clock tick (serviced by function TIMER0_A0_ISR)
 //				Timer0_A1	BlueRobin timer 
 //				Timer0_A2	1/100 sec Stopwatch
-//				Timer0_A3	Configurable periodic IRQ (used by button_repeat and buzzer)
-//				Timer0_A4	One-time delay
+//				Timer0_A3	Software timers (button repeat, buzzer, delays)
 // @param       none
 // @return      none
 // *************************************************************************************************
 #pragma vector = TIMER0_A1_VECTOR
 __interrupt void TIMER0_A1_5_ISR(void)
 {
-	u16 value;
+	struct soft_timer * timer;
 		
 	switch (TA0IV)
 	{
@@ -485,28 +587,29 @@ __interrupt void TIMER0_A1_5_ISR(void)
 					stopwatch_tick();
 					break;
 					
-		// Timer0_A3	Configurable periodic IRQ (used by button_repeat and buzzer)			
-		case 0x06:	// Disable IE 
-					TA0CCTL3 &= ~CCIE;
-					// Reset IRQ flag  
+		// Timer0_A3	Software timers
+		case 0x06:	// Reset IRQ flag, it may have been set by program_soft_timer()
 					TA0CCTL3 &= ~CCIFG;  
-					// Store new value in CCR
-					value = TA0R + sTimer.timer0_A3_ticks; //timer0_A3_ticks_g;
-					// Load CCR register with next capture point
-					TA0CCR3 = value;   
-					// Enable timer interrupt    
-					TA0CCTL3 |= CCIE; 	
-					// Call function handler
-					fptr_Timer0_A3_function();
-					break;
-		
-		// Timer0_A4	One-time delay			
-		case 0x08:	// Disable IE 
-					TA0CCTL4 &= ~CCIE;
-					// Reset IRQ flag  
-					TA0CCTL4 &= ~CCIFG;  
-					// Set delay over flag
-					sys.flag.delay_over = 1;
+					// Expire all timers that are due
+					while ((sTimer.head != 0) && ((s16)(sTimer.head->deadline - TA0R) <= 0))
+					{
+						timer = sTimer.head;
+						sTimer.head = timer->next;
+						if (timer->period != 0)
+						{
+							// Periodic timers advance from their deadline, so they do not drift
+							timer->deadline += timer->period;
+							insert_soft_timer(timer);
+						}
+						else
+						{
+							timer->active = 0;
+						}
+						// Call function handler
+						if (timer->callback != 0) timer->callback();
+					}
+					// Load CCR register with the next deadline
+					program_soft_timer();
 					break;
 	}
 	
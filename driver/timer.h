@@ -45,18 +45,40 @@
 extern void Timer0_Init(void);
 extern void Timer0_Start(void);
 extern void Timer0_Stop(void);
-extern void Timer0_A3_Start(u16 ticks);
-extern void Timer0_A3_Stop(void);
+struct soft_timer;
+extern void start_soft_timer(struct soft_timer * timer, u16 ticks, u16 period, void (*callback)(void));
+extern void stop_soft_timer(struct soft_timer * timer);
+extern u8 is_soft_timer(struct soft_timer * timer);
 extern void Timer0_A4_Delay(u16 ticks);
-extern void (*fptr_Timer0_A3_function)(void);
 
 
 // *************************************************************************************************
 // Defines section
+
+// Software timer on Timer0_A3. Ticks and period must stay below half the Timer0 range 
+// (32768 ticks = 1 sec).
+struct soft_timer
+{
+	// Next timer in the deadline list
+	struct soft_timer *	next;
+	
+	// TA0R value of the next expiry
+	u16		deadline;
+	
+	// Period in ticks, 0 = one-shot
+	u16		period;
+	
+	// Called in ISR context on expiry
+	void	(*callback)(void);
+	
+	// 1 = timer runs
+	u8		active;
+};
+
 struct timer
 {
-	// Timer0_A3 periodic delay 
-	u16		timer0_A3_ticks;
+	// Running software timers sorted by deadline
+	struct soft_timer *	head;
 };
 extern struct timer sTimer;
 
@@ -48,15 +48,31 @@
 // driver
 #include "vti_as.h"
 #include "timer.h"
+#include "event.h"
 #include "display.h"
+#include "ports.h"
 
 
 // *************************************************************************************************
 // Prototypes section
-void as_start(void);
+void as_start(u16 rate, u8 range);
 void as_stop(void);
 u8 as_read_register(u8 bAddress);
 u8 as_write_register(u8 bAddress, u8 bData);
+void as_set_mode(u8 mode);
+u16 as_set_rate(u16 rate);
+u8 as_select_rate(u16 rate);
+u8 as_ctrl_config(u8 mode);
+u8 as_spi_frame(u8 bHeader, u8 bData);
+void as_wait_dma(void);
+void as_dma_start_frame(void);
+u8 as_int_event(void);
+u16 as_get_sample(u8 * data);
+void as_reset_samples(void);
+u8 as_is_batch_ready(void);
+void as_set_rate_trigger(u16 threshold_mg, u16 rate);
+u8 as_mg_to_lsb(u16 mg);
+u8 as_is_rate_trigger(void);
 
 
 // *************************************************************************************************
@@ -69,14 +85,24 @@ u8 as_write_register(u8 bAddress, u8 bData);
 // Speed in Hz = 12MHz / AS_BR_DIVIDER (max. 500kHz)
 #define AS_BR_DIVIDER        (30u)
 
-// Acceleration measurement range in g
-// Valid ranges are: 2 and 8
-#define AS_RANGE             (8u)
+// Free fall detection mode: the sensor samples internally with 100Hz and raises INT only
+// when all axes stay below the threshold for the given time
+// FFTHR threshold 0.5g (71mg/LSB at 8g range, 18mg/LSB at 2g range)
+#define AS_FREE_FALL_THRESHOLD_MG	(500u)
+// FFTMR free fall time 100ms (10ms/LSB at 100Hz)
+#define AS_FREE_FALL_TIME		(10u)
 
-// Sample rate for acceleration values in Hz
-// Valid sample rates for 2g range are:     100, 400
-// Valid sample rates for 8g range are: 40, 100, 400
-#define AS_SAMPLE_RATE       (40u)
+
+// Sample ring size (power of 2)
+#define AS_RING_SIZE			(32u)
+
+// Sample rate is stored with every sample in units of 10Hz
+#define AS_RATE_TAG_UNIT		(10u)
+
+// Samples processed per main loop wake-up: 250ms of data, but leave room in the ring for
+// samples arriving while the batch is processed
+#define AS_RING_BATCH_TIME_DIV	(4u)
+#define AS_RING_BATCH_MAX		(AS_RING_SIZE * 3u / 4u)
 
 
 // *************************************************************************************************
@@ -85,6 +111,44 @@ u8 as_write_register(u8 bAddress, u8 bData);
 // Global flag for proper acceleration sensor operation
 u8 as_ok;
 
+// Current sensor operating mode
+u8 as_mode;
+
+// Current measurement range (g) and sample rate (Hz)
+u8 as_range;
+u16 as_rate;
+
+// X/Y/Z sample currently read by DMA
+u8 as_dma_xyz[3];
+
+// Sample ring filled by DMA ISR, emptied in batches by main loop. X/Y/Z and sample rate tag.
+u8 as_ring[AS_RING_SIZE][4];
+volatile u8 as_ring_write;				// Only changed by DMA ISR
+volatile u8 as_ring_read;				// Only changed by main loop
+
+// Number of samples dropped because the sample ring was full
+u8 as_ring_overflow;
+
+// Number of samples that wake up the main loop
+u8 as_ring_batch;
+
+// 1 = EVENT_ACCELERATION was posted for the samples in the ring, cleared by the consumer
+volatile u8 as_ring_event;
+
+// DMA ISR switches to as_trigger_rate on the first sample with a magnitude not above 
+// as_trigger_threshold (LSB), 0 = no trigger armed
+volatile u8 as_trigger_threshold;
+u16 as_trigger_rate;
+
+// Bytes received by DMA during one register frame (status, register content)
+u8 as_dma_rx[2];
+
+// Dummy byte written by DMA to clock in the register content
+u8 as_dma_tx;
+
+// Register frame (0=X, 1=Y, 2=Z) of running DMA read, AS_DMA_IDLE when no read is in progress
+volatile u8 as_dma_frame = AS_DMA_IDLE;
+
 
 // *************************************************************************************************
 // Extern section
@@ -128,13 +192,19 @@ void as_init(void)
 // *************************************************************************************************
 // @fn          as_start
 // @brief       Power-up and initialize acceleration sensor
-// @param       none
+// @param       u16 rate		Sample rate in Hz (AS_RATE_40HZ, AS_RATE_100HZ, AS_RATE_400HZ)
+//				u8 range		Measurement range in g (AS_RANGE_2G, AS_RANGE_8G)
 // @return      none
 // *************************************************************************************************
-void as_start(void)
+void as_start(u16 rate, u8 range)
 {
 	volatile u16 Counter_u16;
-	u8 bConfig;//, bStatus;
+	
+	// Store configuration, unsupported values select the next supported setting
+	if (range == AS_RANGE_2G) 	as_range = AS_RANGE_2G;
+	else						as_range = AS_RANGE_8G;
+	as_rate = 0;
+	as_set_rate(rate);
 	
 	// Initialize SPI interface to acceleration sensor
 	AS_SPI_CTL0 |= UCSYNC | UCMST | UCMSB // SPI master, 8 data bits,  MSB first,
@@ -144,6 +214,25 @@ void as_start(void)
 	AS_SPI_BR1   = 0x00;                  // High byte of division factor for baud rate
 	AS_SPI_CTL1 &= ~UCSWRST;              // Start SPI hardware
   
+	// Initialize DMA for sample read: channel 0 copies RX buffer to as_dma_rx, 
+	// channel 1 writes the dummy byte to TX buffer. SMCLK stays requested by USCI 
+	// during LPM3, so the CPU can sleep while a frame is clocked.
+	DMACTL0 = (AS_DMA_TRIGGER_TX << 8) | AS_DMA_TRIGGER_RX;	// DMA1TSEL, DMA0TSEL
+	DMACTL4 = DMARMWDIS;                  // No transfer during CPU read-modify-write
+	__data16_write_addr((u16)&DMA0SA, (u32)&AS_RX_BUFFER);
+	__data16_write_addr((u16)&DMA0DA, (u32)as_dma_rx);
+	DMA0SZ  = 2;
+	DMA0CTL = DMADT_0 | DMADSTINCR_3 | DMASRCBYTE | DMADSTBYTE | DMAIE;	// Single transfer, increment destination
+	as_dma_tx = 0;
+	__data16_write_addr((u16)&DMA1SA, (u32)&as_dma_tx);
+	__data16_write_addr((u16)&DMA1DA, (u32)&AS_TX_BUFFER);
+	DMA1SZ  = 1;
+	DMA1CTL = DMADT_0 | DMASRCBYTE | DMADSTBYTE;		// Single transfer, fixed addresses
+	as_dma_frame = AS_DMA_IDLE;
+	as_reset_samples();
+	as_ring_overflow = 0;
+	as_trigger_threshold = 0;
+  
 	// Initialize interrupt pin for data read out from acceleration sensor
 	AS_INT_IES &= ~AS_INT_PIN;            // Interrupt on rising edge
 
@@ -164,31 +253,6 @@ void as_start(void)
 	AS_INT_IFG &= ~AS_INT_PIN;            // Reset flag
 	AS_INT_IE  |=  AS_INT_PIN;            // Enable interrupt
 	
-	// Configure sensor and start to sample data
-#if (AS_RANGE == 2)
-  bConfig = 0x80;
-  #if (AS_SAMPLE_RATE == 100)
-    bConfig |= 0x02;
-  #elif (AS_SAMPLE_RATE == 400)
-    bConfig |= 0x04;
-  #else
-    #error "Sample rate not supported"
-  #endif
-#elif (AS_RANGE == 8)
-  bConfig = 0x00;
-  #if (AS_SAMPLE_RATE == 40)
-    bConfig |= 0x06;
-  #elif (AS_SAMPLE_RATE == 100)
-    bConfig |= 0x02;
-  #elif (AS_SAMPLE_RATE == 400)
-    bConfig |= 0x04;
-  #else
-    #error "Sample rate not supported"
-  #endif
-#else
-  #error "Measurement range not supported"    
-#endif  
-
 	// Reset sensor
 	as_write_register(0x04, 0x02);   
 	as_write_register(0x04, 0x0A);   
@@ -197,8 +261,188 @@ void as_start(void)
 	// Wait 5 ms before starting sensor output
 	Timer0_A4_Delay(CONV_MS_TO_TICKS(5));
 	
-	// Set 2g measurement range, start to output data with 100Hz rate
-	as_write_register(0x02, bConfig);   
+	// Set measurement range, start to output data with as_rate
+	as_set_mode(AS_MODE_MEASUREMENT);
+}
+
+
+// *************************************************************************************************
+// @fn          as_set_mode
+// @brief       Switch powered sensor between measurement and free fall detection mode.
+//				In free fall detection mode the MCU can stay in LPM3 until the sensor INT
+//				signals a free fall, instead of waking up on every DRDY edge.
+// @param       u8 mode		AS_MODE_MEASUREMENT, AS_MODE_FREE_FALL
+// @return      none
+// *************************************************************************************************
+void as_set_mode(u8 mode)
+{
+	if (mode == AS_MODE_FREE_FALL)
+	{
+		// Free fall time and threshold
+		as_write_register(AS_ADDR_MDFFTMR, AS_FREE_FALL_TIME);
+		as_write_register(AS_ADDR_FFTHR, as_mg_to_lsb(AS_FREE_FALL_THRESHOLD_MG));
+	}
+	
+	// Discard pending INT edge of the previous mode. INT edges held off during the
+	// register write are handled according to the new mode.
+	AS_INT_IFG &= ~AS_INT_PIN;
+	as_mode = mode;
+	
+	as_write_register(AS_ADDR_CTRL, as_ctrl_config(mode));
+}
+
+
+// *************************************************************************************************
+// @fn          as_ctrl_config
+// @brief       CTRL register content for a mode with the current range and sample rate.
+// @param       u8 mode		AS_MODE_MEASUREMENT, AS_MODE_FREE_FALL
+// @return      u8			CTRL register content
+// *************************************************************************************************
+u8 as_ctrl_config(u8 mode)
+{
+	u8 bConfig;
+	
+	// Configure measurement range
+	if (as_range == AS_RANGE_2G)	bConfig = 0x80;
+	else							bConfig = 0x00;
+
+	if (mode == AS_MODE_FREE_FALL)
+	{
+		// Free fall detection with 100Hz
+		bConfig |= 0x0A;
+	}
+	else
+	{
+		// Start to sample data (as_select_rate() only accepts rates valid for the range)
+		switch (as_rate)
+		{
+			case AS_RATE_40HZ:	bConfig |= 0x06; break;
+			case AS_RATE_100HZ:	bConfig |= 0x02; break;
+			default:			bConfig |= 0x04; break;
+		}
+	}
+	
+	return (bConfig);
+}
+
+
+// *************************************************************************************************
+// @fn          as_set_rate
+// @brief       Select sample rate of measurement mode. A running measurement switches to the new
+//				rate immediately, so the rate can follow the needs of the application. The rate 
+//				trigger also changes the rate from DMA ISR, so disarm it before calling.
+// @param       u16 rate		Requested sample rate in Hz. Rounded up to the next rate supported
+//								in the current range (2g: 100, 400; 8g: 40, 100, 400).
+// @return      u16				Active sample rate in Hz
+// *************************************************************************************************
+u16 as_set_rate(u16 rate)
+{
+	if (as_select_rate(rate))
+	{
+		// Sensor is running while its interrupt is enabled
+		if ((AS_INT_IE & AS_INT_PIN) && (as_mode == AS_MODE_MEASUREMENT))
+		{
+			as_set_mode(AS_MODE_MEASUREMENT);
+		}
+	}
+	
+	return (as_rate);
+}
+
+
+// *************************************************************************************************
+// @fn          as_select_rate
+// @brief       Round a requested sample rate to a supported one and make it the current rate.
+//				Does not access the sensor, so the DMA ISR can use it.
+// @param       u16 rate		Requested sample rate in Hz, see as_set_rate()
+// @return      u8				1 = rate changed, the sensor CTRL register has to be written
+// *************************************************************************************************
+u8 as_select_rate(u16 rate)
+{
+	if ((rate <= AS_RATE_40HZ) && (as_range == AS_RANGE_8G)) 	rate = AS_RATE_40HZ;
+	else if (rate <= AS_RATE_100HZ)								rate = AS_RATE_100HZ;
+	else														rate = AS_RATE_400HZ;
+	
+	if (rate == as_rate) return (0);
+	
+	as_rate = rate;
+	
+	// Wake up main loop every 250ms
+	as_ring_batch = as_rate / AS_RING_BATCH_TIME_DIV;
+	if (as_ring_batch > AS_RING_BATCH_MAX) as_ring_batch = AS_RING_BATCH_MAX;
+	
+	return (1);
+}
+
+
+// *************************************************************************************************
+// @fn          as_set_rate_trigger
+// @brief       Arm the DMA ISR to switch to another sample rate on the first sample with a 
+//				magnitude not above threshold. The rate changes with the triggering sample instead 
+//				of a batch later in the main loop: the DMA writes the CTRL register in a fourth
+//				register frame after the sample. The trigger disarms itself when it fires.
+// @param       u16 threshold_mg	Magnitude threshold in mgrav, 0 = disarm
+//				u16 rate			Sample rate in Hz, see as_set_rate()
+// @return      none
+// *************************************************************************************************
+void as_set_rate_trigger(u16 threshold_mg, u16 rate)
+{
+	// Disarm while changing, the DMA ISR must not see a half written trigger
+	as_trigger_threshold = 0;
+	as_trigger_rate = rate;
+	as_trigger_threshold = as_mg_to_lsb(threshold_mg);
+}
+
+
+// *************************************************************************************************
+// @fn          as_mg_to_lsb
+// @brief       Convert an acceleration to sensor LSB of the current range (18mg/LSB at 2g range, 
+//				71mg/LSB at 8g range).
+// @param       u16 mg			Acceleration in mgrav
+// @return      u8				Acceleration in LSB, rounded down
+// *************************************************************************************************
+u8 as_mg_to_lsb(u16 mg)
+{
+	if (as_range == AS_RANGE_2G)	return (mg / 18);
+	else							return (mg / 71);
+}
+
+
+// *************************************************************************************************
+// @fn          as_is_rate_trigger
+// @brief       Check the sample just read by DMA against the armed rate trigger. Squares are
+//				compared, so the hardware multiplier does the work and no root is needed.
+// @param       none
+// @return      u8		1 = magnitude not above as_trigger_threshold
+// *************************************************************************************************
+u8 as_is_rate_trigger(void)
+{
+	u8 i;
+	s8 value;
+	u16 sum = 0;
+	u8 threshold = as_trigger_threshold;
+	
+	if (threshold == 0) return (0);
+	
+	// At most 3 * 128^2, fits into 16 bit
+	for (i=0; i<3; i++)
+	{
+		value = (s8)as_dma_xyz[i];
+		sum += (u16)((s16)value * value);
+	}
+	return (sum <= (u16)threshold * threshold);
+}
+
+
+// *************************************************************************************************
+// @fn          as_get_interrupt_status
+// @brief       Read INT_STATUS register. Reading clears the sensor interrupt.
+// @param       none
+// @return      u8		INT_STATUS register content (AS_INT_STATUS_FFDET)
+// *************************************************************************************************
+u8 as_get_interrupt_status(void)
+{
+	return (as_read_register(AS_ADDR_INT_STATUS));
 }
 
 
@@ -213,6 +457,9 @@ void as_stop(void)
 {
 	// Disable interrupt 
 	AS_INT_IE  &=  ~AS_INT_PIN;            	// Disable interrupt
+	
+	// Let running sample read finish
+	as_wait_dma();
 
 #ifdef AS_DISCONNECT
 	// Power-down sensor
@@ -234,44 +481,80 @@ void as_stop(void)
 
 
 // *************************************************************************************************
-// @fn          as_read_register
-// @brief       Read a byte from the acceleration sensor
-// @param       u8 bAddress		Register address
-// @return      u8					Register content
+// @fn          as_wait_dma
+// @brief       Wait until a DMA sample read has finished. Abort the transfer if the sensor does
+//				not respond.
+// @param       none
+// @return      none
 // *************************************************************************************************
-u8 as_read_register(u8 bAddress)
+void as_wait_dma(void)
+{
+  u16 timeout;
+  
+  timeout = SPI_TIMEOUT;
+  while ((as_dma_frame != AS_DMA_IDLE) && (--timeout>0));
+  if (timeout == 0)
+  {
+  	// Stop DMA channels and release sensor
+  	DMA0CTL &= ~DMAEN;
+  	DMA1CTL &= ~DMAEN;
+  	AS_CSN_OUT |=  AS_CSN_PIN;
+  	AS_SPI_REN |=  AS_SDI_PIN;
+  	as_dma_frame = AS_DMA_IDLE;
+  	as_ok = 0;
+  }
+}
+
+
+// *************************************************************************************************
+// @fn          as_spi_frame
+// @brief       Transfer one register frame (address byte and data byte) by polling the SPI.
+//				DRDY interrupts are held off during the frame, so that a DMA sample read cannot
+//				interleave. A DRDY edge during the frame stays pending and starts the DMA read
+//				afterwards.
+// @param       u8 bHeader		Shifted register address with RW bit
+//				u8 bData			Data byte, dummy byte for read access
+// @return      u8					Byte received during data byte
+// *************************************************************************************************
+u8 as_spi_frame(u8 bHeader, u8 bData)
 {
   u8 bResult;
+  u8 int_enable;
   u16 timeout;
   
   // Exit function if an error was detected previously
   if (!as_ok) return (0);
 
-  bAddress <<= 2;                     // Address to be shifted left by 2 and RW bit to be reset
+  // Hold off DRDY interrupt and let a running DMA read complete
+  int_enable = AS_INT_IE & AS_INT_PIN;
+  AS_INT_IE &= ~AS_INT_PIN;
+  as_wait_dma();
 
   AS_SPI_REN &= ~AS_SDI_PIN;          // Pulldown on SDI pin not required
   AS_CSN_OUT &= ~AS_CSN_PIN;          // Select acceleration sensor
 
   bResult = AS_RX_BUFFER;             // Read RX buffer just to clear interrupt flag
 
-  AS_TX_BUFFER = bAddress;            // Write address to TX buffer
+  AS_TX_BUFFER = bHeader;             // Write address to TX buffer
   
   timeout = SPI_TIMEOUT;
   while (!(AS_IRQ_REG & AS_RX_IFG) && (--timeout>0));  // Wait until new data was written into RX buffer
   if (timeout == 0)
   {
   	as_ok = 0;
+  	AS_INT_IE |= int_enable;
   	return (0);
   }
   bResult = AS_RX_BUFFER;             // Read RX buffer just to clear interrupt flag
 
-  AS_TX_BUFFER = 0;                   // Write dummy data to TX buffer
+  AS_TX_BUFFER = bData;               // Write data to TX buffer
   
   timeout = SPI_TIMEOUT;
   while (!(AS_IRQ_REG & AS_RX_IFG) && (--timeout>0));  // Wait until new data was written into RX buffer
   if (timeout == 0)
   {
   	as_ok = 0;
+  	AS_INT_IE |= int_enable;
   	return (0);
   }
   bResult = AS_RX_BUFFER;             // Read RX buffer
@@ -279,11 +562,24 @@ u8 as_read_register(u8 bAddress)
   AS_CSN_OUT |=  AS_CSN_PIN;          // Deselect acceleration sensor
   AS_SPI_REN |=  AS_SDI_PIN;          // Pulldown on SDI pin required again
 
-  // Return new data from RX buffer
+  AS_INT_IE |= int_enable;
   return bResult;
 }
 
 
+// *************************************************************************************************
+// @fn          as_read_register
+// @brief       Read a byte from the acceleration sensor
+// @param       u8 bAddress		Register address
+// @return      u8					Register content
+// *************************************************************************************************
+u8 as_read_register(u8 bAddress)
+{
+  // Address to be shifted left by 2 and RW bit to be reset
+  return (as_spi_frame(bAddress << 2, 0));
+}
+
+
 // *************************************************************************************************
 // @fn          as_write_register
 // @brief  		Write a byte to the acceleration sensor
@@ -293,46 +589,207 @@ u8 as_read_register(u8 bAddress)
 // *************************************************************************************************
 u8 as_write_register(u8 bAddress, u8 bData)
 {
-  u8 bResult;
-  u16 timeout;
-  
-  // Exit function if an error was detected previously
-  if (!as_ok) return (0);
+  // Address to be shifted left by 2 and RW bit to be set
+  return (as_spi_frame((bAddress << 2) | BIT1, bData));
+}
 
-  bAddress <<= 2;                     // Address to be shifted left by 1
-  bAddress |= BIT1;                   // RW bit to be set
-  
-  AS_SPI_REN &= ~AS_SDI_PIN;          // Pulldown on SDI pin not required
-  AS_CSN_OUT &= ~AS_CSN_PIN;          // Select acceleration sensor
 
-  bResult = AS_RX_BUFFER;             // Read RX buffer just to clear interrupt flag
+// *************************************************************************************************
+// @fn          as_dma_start_frame
+// @brief       Select sensor and start DMA transfer of the register frame as_dma_frame.
+//				DMA1 writes the dummy byte (the CTRL content for AS_DMA_CTRL) as soon as the 
+//				address byte has moved to the shift register, DMA0 stores both received bytes. 
+//				DMA0 interrupt ends the frame.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void as_dma_start_frame(void)
+{
+	u8 bDummy;
+	
+	AS_CSN_OUT &= ~AS_CSN_PIN;          // Select acceleration sensor
 
-  AS_TX_BUFFER = bAddress;            // Write address to TX buffer
-  
-  timeout = SPI_TIMEOUT;
-  while (!(AS_IRQ_REG & AS_RX_IFG) && (--timeout>0));  // Wait until new data was written into RX buffer
-  if (timeout == 0)
-  {
-  	as_ok = 0;
-  	return (0);
-  }
-  bResult = AS_RX_BUFFER;             // Read RX buffer just to clear interrupt flag
+	bDummy = AS_RX_BUFFER;              // Clear RX flag, DMA0 triggers on next rising edge
+	
+	// Channel addresses and sizes are reloaded from the registers on every enable
+	DMA0CTL |= DMAEN;
+	DMA1CTL |= DMAEN;
+	
+	if (as_dma_frame == AS_DMA_CTRL)	AS_TX_BUFFER = (AS_ADDR_CTRL << 2) | BIT1;			// Write access to CTRL
+	else								AS_TX_BUFFER = (AS_ADDR_DOUTX + as_dma_frame) << 2;	// Read access to DOUTX/Y/Z
+}
 
-  AS_TX_BUFFER = bData;               // Write data to TX buffer
 
-  timeout = SPI_TIMEOUT;
-  while (!(AS_IRQ_REG & AS_RX_IFG) && (--timeout>0));  // Wait until new data was written into RX buffer
-  if (timeout == 0) 
-  {
-  	as_ok = 0;
-  	return (0);
-  }
-  bResult = AS_RX_BUFFER;             // Read RX buffer
+// *************************************************************************************************
+// @fn          as_int_event
+// @brief       Handle INT edge from sensor (called from PORT2 ISR and the 1Hz timer tick).
+//				In measurement mode INT is DRDY: read X/Y/Z in background with DMA, the DMA ISR 
+//				requests processing when a batch of samples is complete. In free fall mode INT signals 
+//				a free fall, so processing is requested immediately.
+// @param       none
+// @return      u8		1 = main loop has to wake up now, 0 = CPU can stay in LPM
+// *************************************************************************************************
+u8 as_int_event(void)
+{
+	if (as_mode == AS_MODE_FREE_FALL)
+	{
+		post_event(EVENT_FREE_FALL, 0);
+		return (1);
+	}
+	
+	// Sample read still in progress, polled register access ongoing or sensor failed
+	if (!as_ok || (as_dma_frame != AS_DMA_IDLE) || !(AS_INT_IE & AS_INT_PIN)) return (0);
+	
+	AS_SPI_REN &= ~AS_SDI_PIN;          // Pulldown on SDI pin not required
+	as_dma_frame = 0;
+	as_dma_start_frame();
+	
+	return (0);
+}
 
-  AS_CSN_OUT |=  AS_CSN_PIN;          // Deselect acceleration sensor
-  AS_SPI_REN |=  AS_SDI_PIN;          // Pulldown on SDI pin required again
 
-  return bResult;
+// *************************************************************************************************
+// @fn          as_get_sample
+// @brief       Take oldest X/Y/Z sample from sample ring. Samples taken before a rate change can
+//				still wait in the ring, so the rate is returned with every sample.
+// @param       u8 * data		Buffer for X/Y/Z acceleration data
+// @return      u16				Sample rate of the sample in Hz, 0 = ring empty
+// *************************************************************************************************
+u16 as_get_sample(u8 * data)
+{
+	u16 rate;
+	u8 * sample;
+	
+	// Write index is only advanced by DMA ISR, a stale value just delays the sample
+	if (as_ring_read == as_ring_write) return (0);
+	
+	sample = as_ring[as_ring_read & (AS_RING_SIZE - 1)];
+	*(data+0) = *(sample+0);
+	*(data+1) = *(sample+1);
+	*(data+2) = *(sample+2);
+	rate = (u16)*(sample+3) * AS_RATE_TAG_UNIT;
+	
+	// Release slot for DMA ISR
+	as_ring_read++;
+	return (rate);
+}
+
+
+// *************************************************************************************************
+// @fn          as_is_batch_ready
+// @brief       Returns 1 if a batch of samples waits in the sample ring.
+// @param       none
+// @return      u8
+// *************************************************************************************************
+u8 as_is_batch_ready(void)
+{
+	return ((u8)(as_ring_write - as_ring_read) >= as_ring_batch);
+}
+
+
+// *************************************************************************************************
+// @fn          as_reset_samples
+// @brief       Discard all samples in sample ring.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void as_reset_samples(void)
+{
+	__disable_interrupt();
+	as_ring_read = as_ring_write;
+	as_ring_event = 0;
+	__enable_interrupt();
+}
+
+
+// *************************************************************************************************
+// @fn          DMA_ISR
+// @brief       DMA0 completed a register frame. Store axis and continue with next register.
+//				After Z the sample is pushed to the sample ring. A rate change of the rate trigger
+//				is written to the sensor by DMA as well, the ISR never polls the SPI.
+// @param       none
+// @return      none
+// *************************************************************************************************
+#pragma vector=DMA_VECTOR
+__interrupt void DMA_ISR(void)
+{
+	u8 * sample;
+	
+#ifdef USE_DRDY_LATENCY_PROBE
+	DRDY_PROBE_OUT |= DRDY_PROBE_PIN;
+#endif
+
+	switch (__even_in_range(DMAIV, 16))
+	{
+		case 2:	// DMA0IFG
+			AS_CSN_OUT |= AS_CSN_PIN;          // Deselect acceleration sensor
+			
+			// CTRL written, DMA1 sends dummy bytes again
+			if (as_dma_frame == AS_DMA_CTRL)
+			{
+				as_dma_tx = 0;
+				as_dma_frame = AS_DMA_IDLE;
+				AS_SPI_REN |=  AS_SDI_PIN;          // Pulldown on SDI pin required again
+				break;
+			}
+			
+			// Second byte of frame is register content
+			as_dma_xyz[as_dma_frame] = as_dma_rx[1];
+			
+			if (++as_dma_frame < 3)
+			{
+				as_dma_start_frame();
+			}
+			else
+			{
+				as_dma_frame = AS_DMA_IDLE;
+				
+				// Store sample in ring, drop it if main loop did not keep up
+				if ((u8)(as_ring_write - as_ring_read) < AS_RING_SIZE)
+				{
+					sample = as_ring[as_ring_write & (AS_RING_SIZE - 1)];
+					*(sample+0) = as_dma_xyz[0];
+					*(sample+1) = as_dma_xyz[1];
+					*(sample+2) = as_dma_xyz[2];
+					*(sample+3) = (u8)(as_rate / AS_RATE_TAG_UNIT);
+					as_ring_write++;
+				}
+				else
+				{
+					as_ring_overflow++;
+				}
+				
+				// Switch rate right away, the next samples are taken with the new rate. The 
+				// sample was tagged with the old rate. CTRL is written as the next frame.
+				if (as_is_rate_trigger())
+				{
+					as_trigger_threshold = 0;
+					if (as_select_rate(as_trigger_rate) && (as_mode == AS_MODE_MEASUREMENT))
+					{
+						as_dma_tx = as_ctrl_config(AS_MODE_MEASUREMENT);
+						as_dma_frame = AS_DMA_CTRL;
+						as_dma_start_frame();
+					}
+				}
+				if (as_dma_frame == AS_DMA_IDLE) AS_SPI_REN |=  AS_SDI_PIN;	// Pulldown on SDI pin required again
+				
+				// Process samples in main loop once a batch is complete. One event is posted for 
+				// the samples in the ring, it is tried again with every following sample if the
+				// event ring was full.
+				if ((u8)(as_ring_write - as_ring_read) >= as_ring_batch)
+				{
+					if (!as_ring_event && post_event(EVENT_ACCELERATION, as_ring_write)) as_ring_event = 1;
+					__bic_SR_register_on_exit(LPM3_bits);
+				}
+			}
+			break;
+		default:
+			break;
+	}
+
+#ifdef USE_DRDY_LATENCY_PROBE
+	DRDY_PROBE_OUT &= ~DRDY_PROBE_PIN;
+#endif
 }
 
 
@@ -348,9 +805,9 @@ void as_get_data(u8 * data)
 	if ((AS_PWR_OUT & AS_PWR_PIN) != AS_PWR_PIN) return;
   
   	// Store X/Y/Z acceleration data in buffer
-	*(data+0) = as_read_register(0x06);
-	*(data+1) = as_read_register(0x07);
-	*(data+2) = as_read_register(0x08);
+	*(data+0) = as_read_register(AS_ADDR_DOUTX);
+	*(data+1) = as_read_register(AS_ADDR_DOUTY);
+	*(data+2) = as_read_register(AS_ADDR_DOUTZ);
 }
 
 
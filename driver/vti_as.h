@@ -44,11 +44,19 @@
 // *************************************************************************************************
 // Prototypes section
 extern void as_init(void);
-extern void as_start(void);
+extern void as_start(u16 rate, u8 range);
 extern void as_stop(void);
 extern u8 as_read_register(u8 bAddress);
 extern u8 as_write_register(u8 bAddress, u8 bData);
 extern void as_get_data(u8 * data);
+extern void as_set_mode(u8 mode);
+extern u16 as_set_rate(u16 rate);
+extern u8 as_get_interrupt_status(void);
+extern u8 as_int_event(void);
+extern u16 as_get_sample(u8 * data);
+extern u8 as_is_batch_ready(void);
+extern void as_reset_samples(void);
+extern void as_set_rate_trigger(u16 threshold_mg, u16 rate);
 
 
 // *************************************************************************************************
@@ -83,6 +91,10 @@ extern void as_get_data(u8 * data);
 #define AS_SPI_BR0           (UCA0BR0)
 #define AS_SPI_BR1           (UCA0BR1)
 
+// DMA trigger sources of USCI_A0 (CC430F613x DMA trigger assignments)
+#define AS_DMA_TRIGGER_RX    (16u)          // UCA0RXIFG
+#define AS_DMA_TRIGGER_TX    (17u)          // UCA0TXIFG
+
 // Port and pin resource for power-up of acceleration sensor, VDD=PJ.0
 #define AS_PWR_OUT           (PJOUT)
 #define AS_PWR_DIR           (PJDIR)
@@ -100,9 +112,48 @@ extern void as_get_data(u8 * data);
 // SPI timeout to detect sensor failure
 #define SPI_TIMEOUT				(1000u)
 
+// CMA3000-D0x register addresses
+#define AS_ADDR_CTRL			(0x02)
+#define AS_ADDR_RSTR			(0x04)
+#define AS_ADDR_INT_STATUS		(0x05)
+#define AS_ADDR_DOUTX			(0x06)
+#define AS_ADDR_DOUTY			(0x07)
+#define AS_ADDR_DOUTZ			(0x08)
+#define AS_ADDR_MDFFTMR			(0x0A)
+#define AS_ADDR_FFTHR			(0x0B)
+
+// INT_STATUS register: free fall detected
+#define AS_INT_STATUS_FFDET		(BIT2)
+
+// Sensor operating modes
+#define AS_MODE_MEASUREMENT		(0u)	// Output data with as_rate, DRDY on every sample
+#define AS_MODE_FREE_FALL		(1u)	// Sensor detects free fall internally, INT only on free fall
+
+// Measurement ranges in g
+#define AS_RANGE_2G				(2u)
+#define AS_RANGE_8G				(8u)
+
+// Sample rates in Hz
+// Valid sample rates for 2g range are:     100, 400
+// Valid sample rates for 8g range are: 40, 100, 400
+#define AS_RATE_40HZ			(40u)
+#define AS_RATE_100HZ			(100u)
+#define AS_RATE_400HZ			(400u)
+
+// DMA sample read: no register frame in progress
+#define AS_DMA_IDLE				(0xFFu)
+
+// DMA register frame after DOUTZ: CTRL write of a rate trigger
+#define AS_DMA_CTRL				(3u)
+
 
 // *************************************************************************************************
 // Global Variable section
+extern u8 as_mode;
+extern u8 as_range;
+extern u16 as_rate;
+extern u8 as_ring_overflow;
+extern volatile u8 as_ring_event;
 
 
 // *************************************************************************************************
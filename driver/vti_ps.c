@@ -50,6 +50,7 @@
 // *************************************************************************************************
 // Prototypes section
 u16 ps_read_register(u8 address, u8 mode);
+u8 ps_twi_select(u8 address);
 u8 ps_write_register(u8 address, u8 data);
 u8 ps_twi_read(u8 ack);
 void twi_delay(void);
@@ -62,11 +63,6 @@ void twi_delay(void);
 // *************************************************************************************************
 // Global Variable section
 
-// VTI pressure (hPa) to altitude (m) conversion tables
-const s16 h0[17] = { -153, 0, 111, 540, 989, 1457, 1949, 2466, 3012, 3591, 4206, 4865, 5574, 6344, 7185, 8117, 9164 };
-const u16 p0[17] = { 1031, 1013, 1000, 950, 900, 850, 800, 750, 700, 650, 600, 550, 500, 450, 400, 350, 300 };
-float p[17];
-
 // Global flag for proper pressure sensor operation
 u8 ps_ok;
 
@@ -118,13 +114,14 @@ void ps_init(void)
 // *************************************************************************************************
 // @fn          ps_start
 // @brief       Init pressure sensor registers and start sampling
-// @param       none
-// @return      u8		1=Sensor started, 0=Sensor did not start
+// @param       u8 mode		PS_MODE_HIGH_SPEED, PS_MODE_HIGH_RESOLUTION, PS_MODE_ULTRA_LOW_POWER,
+//							PS_MODE_TRIGGERED (single conversion)
+// @return      none
 // *************************************************************************************************
-void ps_start(void)
+void ps_start(u8 mode)
 {
-	// Start sampling data in ultra low power mode 
-	ps_write_register(0x03, 0x0B);  
+	// Start sampling data in continuous mode, or start one conversion
+	ps_write_register(0x03, mode);  
 }
 
 
@@ -330,6 +327,27 @@ u8 ps_write_register(u8 address, u8 data)
 }
 
 
+// *************************************************************************************************
+// @fn          ps_twi_select
+// @brief       Address a register for reading. Call after a start or restart condition.
+// @param       u8 address		Register address
+// @return      u8				1=Device is ready to send register content, 0=No ACK from device
+// *************************************************************************************************
+u8 ps_twi_select(u8 address)
+{
+  ps_twi_write((0x11<<1) | PS_TWI_WRITE); 	// Send 7bit device address 0x11 + write bit '0'
+  if (!ps_twi_sda(PS_TWI_CHECK_ACK)) return (0);	// Check ACK from device
+  
+  ps_twi_write(address);					// Send 8bit register address
+  if (!ps_twi_sda(PS_TWI_CHECK_ACK)) return (0);	// Check ACK from device
+
+  ps_twi_sda(PS_TWI_SEND_RESTART);			// Generate restart condition
+
+  ps_twi_write((0x11<<1) | PS_TWI_READ); 	// Send 7bit device address 0x11 + read bit '1'
+  return (ps_twi_sda(PS_TWI_CHECK_ACK));	// Check ACK from device
+}
+
+
 // *************************************************************************************************
 // @fn          ps_read_register
 // @brief       Read a byte from the pressure sensor
@@ -339,24 +357,11 @@ u8 ps_write_register(u8 address, u8 data)
 // *************************************************************************************************
 u16 ps_read_register(u8 address, u8 mode)
 {
-  u8 success;
   u16 data = 0;
 
   ps_twi_sda(PS_TWI_SEND_START);			// Generate start condition
 
-  ps_twi_write((0x11<<1) | PS_TWI_WRITE); 	// Send 7bit device address 0x11 + write bit '0'
-  success = ps_twi_sda(PS_TWI_CHECK_ACK);	// Check ACK from device
-  if (!success) return (0);
-  
-  ps_twi_write(address);					// Send 8bit register address
-  success = ps_twi_sda(PS_TWI_CHECK_ACK);	// Check ACK from device
-  if (!success) return (0);
-
-  ps_twi_sda(PS_TWI_SEND_RESTART);			// Generate restart condition
-
-  ps_twi_write((0x11<<1) | PS_TWI_READ); 	// Send 7bit device address 0x11 + read bit '1'
-  success = ps_twi_sda(PS_TWI_CHECK_ACK);	// Check ACK from device
-  if (!success) return (0);
+  if (!ps_twi_select(address)) return (0);
 	
   if (mode == PS_TWI_16BIT_ACCESS)
   {
@@ -376,178 +381,56 @@ u16 ps_read_register(u8 address, u8 mode)
 
 
 // *************************************************************************************************
-// @fn          ps_get_pa
-// @brief       Read out pressure. Format is Pa. Range is 30000 .. 120000 Pa.
-// @param       none
-// @return      u32		15-bit pressure sensor value (Pa)
+// @fn          ps_get_pa_temp
+// @brief       Read out pressure and temperature in one bus transaction. TEMPOUT, DATARD8 and
+//				DATARD16 are addressed through restart conditions, so the bus is not released 
+//				between the registers. Reading DATARD16 last clears DRDY, so all three values
+//				belong to the same conversion. Bus time is the same as for separate reads 
+//				(126 SCL clocks), each register still needs its own address phase. A burst read 
+//				from DATARD8 would need address auto-increment, which the sensor does not document.
+// @param       u32 * pa		Pressure (Pa). Range is 30000 .. 120000 Pa.
+//				u16 * kelvin	Temperature in xx.xK format
+// @return      u8				1=Data read, 0=No ACK from device
 // *************************************************************************************************
-u32 ps_get_pa(void)
+u8 ps_get_pa_temp(u32 * pa, u16 * kelvin)
 {
-	volatile u32 data = 0;
-	
-	// Get 3 MSB from DATARD8 register
-	data = ps_read_register(0x7F, PS_TWI_8BIT_ACCESS);
-	data = ((data & 0x07) << 8) << 8;
+	u16 temp, data;
+	u8 msb;
 
-	// Get 16 LSB from DATARD16 register
-	data |= ps_read_register(0x80, PS_TWI_16BIT_ACCESS);
-	
-	// Convert decimal value to Pa
-	data = (data >> 2);
-	
-	return (data);
-}
-
-
-// *************************************************************************************************
-// @fn          ps_get_temp
-// @brief       Read out temperature.
-// @param       none
-// @return      u16		13-bit temperature value in xx.xK format
-// *************************************************************************************************
-u16 ps_get_temp(void)
-{
-	volatile u16 data = 0;
-	u16 temp = 0;
-	u8 is_negative = 0;
-	u16 kelvin;
+	ps_twi_sda(PS_TWI_SEND_START);
 	
 	// Get 13 bit from TEMPOUT register
-	data = ps_read_register(0x81, PS_TWI_16BIT_ACCESS);
-	
-	// Convert negative temperatures
-	if ((data & BIT(13)) == BIT(13)) 
-	{
-		// Sign extend temperature
-		data |= 0xC000;
-		// Convert two's complement
-		data = ~data;
-		data += 1;
-		is_negative = 1;
-	}
-
-	temp = data / 2;
-	
-	// Convert from C to K
-	if (is_negative)	kelvin = 2732 - temp;
-	else				kelvin = temp + 2732;
-	
-	return (kelvin);
-}
-
-
-// *************************************************************************************************
-// @fn          init_pressure_table
-// @brief       Init pressure table with constants
-// @param       u32		p 		Pressure (Pa)
-// @return      u16				Altitude (m)
-// *************************************************************************************************
-void init_pressure_table(void)
-{
-	u8 i;
-
-	for (i=0; i<17; i++) p[i] = p0[i];
-}
-
-
-// *************************************************************************************************
-// @fn          update_pressure_table
-// @brief       Calculate pressure table for reference altitude.
-//				Implemented straight from VTI reference code.
-// @param       s16		href	Reference height
-//				u32		p_meas	Pressure (Pa)
-//				u16		t_meas	Temperature (10*K)
-// @return     	none
-// *************************************************************************************************
-void update_pressure_table(s16 href, u32 p_meas, u16 t_meas)
-{
-	const float Invt00 = 0.003470415;
-	const float coefp  = 0.00006;
-	volatile float p_fact; 
-	volatile float p_noll;
-	volatile float hnoll;
-	volatile float h_low = 0;
-	volatile float t0;
-	u8 i;
-	
-	// Typecast arguments
-	volatile float fl_href 		= href;
-	volatile float fl_p_meas 	= (float)p_meas/100;	// Convert from Pa to hPa
-	volatile float fl_t_meas	= (float)t_meas/10;		// Convert from 10K to 1K
-
-	t0 = fl_t_meas + (0.0065*fl_href);
+	if (!ps_twi_select(0x81)) return (0);
+	data =  ps_twi_read(1) << 8;
+	data |= ps_twi_read(0);
 	
-	hnoll  = fl_href/(t0*Invt00);
+	// Get 3 MSB from DATARD8 register
+	ps_twi_sda(PS_TWI_SEND_RESTART);
+	if (!ps_twi_select(0x7F)) return (0);
+	msb = ps_twi_read(0);
 	
-	for (i=0; i<=15; i++)
-	{
-		if (h0[i] > hnoll) break;
-		h_low = h0[i];	
-	}
+	// Get 16 LSB from DATARD16 register
+	ps_twi_sda(PS_TWI_SEND_RESTART);
+	if (!ps_twi_select(0x80)) return (0);
+	*pa  = (u32)(msb & 0x07) << 16;
+	*pa |= (u16)(ps_twi_read(1) << 8);
+	*pa |= ps_twi_read(0);
 	
-	p_noll = (float)(hnoll - h_low)*(1 - (hnoll - (float)h0[i])* coefp)*((float)p0[i] - (float)p0[i-1])/((float)h0[i] - h_low) + (float)p0[i-1];
-
-	// Calculate multiplicator
-	p_fact = fl_p_meas/p_noll;
+	ps_twi_sda(PS_TWI_SEND_STOP);
 	
-	// Apply correction factor to pressure table
-	for (i=0; i<=16; i++)
-	{
-		p[i] = p0[i]*p_fact;	
-	}
-}
-
-
-// *************************************************************************************************
-// @fn          conv_pa_to_meter
-// @brief       Convert pressure (Pa) to altitude (m) using a conversion table
-//				Implemented straight from VTI reference code.
-// @param       u32		p_meas	Pressure (Pa)
-//				u16		t_meas	Temperature (10*K)
-// @return      s16				Altitude (m)
-// *************************************************************************************************
-s16 conv_pa_to_meter(u32 p_meas, u16 t_meas)
-{
-	const float coef2  = 0.0007;
-	const float Invt00 = 0.003470415;
-	volatile float hnoll;
-	volatile float t0;
-	volatile float p_low;
-	volatile float fl_h;
-	volatile s16 h;
-	u8 i;
-
-	// Typecast arguments
-	volatile float fl_p_meas = (float)p_meas/100;	// Convert from Pa to hPa
-	volatile float fl_t_meas = (float)t_meas/10;		// Convert from 10K to 1K
+	// Convert decimal value to Pa
+	*pa >>= 2;
 	
-	for (i=0; i<=16; i++)
-	{
-		if (p[i] < fl_p_meas) break;
-		p_low = p[i];
-	}
-		
-	if (i==0) 
-	{
-		hnoll = (float)(fl_p_meas - p[0])/(p[1] - p[0])*((float)(h0[1] - h0[0]));
-	}
-	else if (i<15) 
-	{
-		hnoll = (float)(fl_p_meas - p_low)*(1 - (fl_p_meas - p[i])* coef2)/(p[i] - p_low)*((float)(h0[i] - h0[i-1])) + h0[i-1];
-	}
-	else if (i==15)
+	// Convert negative temperatures (13 bit two's complement, 0.05C)
+	if ((data & BIT(13)) == BIT(13)) 
 	{
-		hnoll = (float)(fl_p_meas - p_low)/(p[i] - p_low)*((float)(h0[i] - h0[i-1])) + h0[i-1];
+		temp = (u16)(~(data | 0xC000) + 1) / 2;
+		*kelvin = 2732 - temp;
 	}
-	else // i==16
+	else
 	{
-		hnoll = (float)(fl_p_meas - p[16])/(p[16] - p[15])*((float)(h0[16] - h0[15])) + h0[16];
+		*kelvin = data / 2 + 2732;
 	}
 	
-	// Compensate temperature error
-	t0 = fl_t_meas/(1 - hnoll*Invt00*0.0065);
-	fl_h = Invt00*t0*hnoll;
-	h = (u16)fl_h;
-	
-	return (h);
+	return (1);
 }
@@ -43,10 +43,9 @@
 // *************************************************************************************************
 // Prototypes section
 extern void ps_init(void);
-extern void ps_start(void);
+extern void ps_start(u8 mode);
 extern void ps_stop(void);
-extern u32 ps_get_pa(void);
-extern u16 ps_get_temp(void);
+extern u8 ps_get_pa_temp(u32 * pa, u16 * kelvin);
 extern void init_pressure_table(void);
 extern void update_pressure_table(s16 href, u32 p_meas, u16 t_meas);
 extern s16 conv_pa_to_meter(u32 p_meas, u16 t_meas);
@@ -82,6 +81,14 @@ extern s16 conv_pa_to_meter(u32 p_meas, u16 t_meas);
 #define	PS_TWI_SEND_STOP	(2u)
 #define	PS_TWI_CHECK_ACK	(3u)
 
+// Continuous measurement modes (OPERATION register)
+#define PS_MODE_HIGH_SPEED			(0x09u)		// 9Hz
+#define PS_MODE_HIGH_RESOLUTION		(0x0Au)		// 1.8Hz
+#define PS_MODE_ULTRA_LOW_POWER		(0x0Bu)
+
+// Low power mode: one conversion per OPERATION write, standby afterwards
+#define PS_MODE_TRIGGERED			(0x0Cu)
+
 #define PS_TWI_8BIT_ACCESS	(0u)
 #define PS_TWI_16BIT_ACCESS	(1u)
 
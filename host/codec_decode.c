@@ -0,0 +1,269 @@
+// *************************************************************************************************
+// Host decoder for the sample codec of the watch (logic/codec.c). Decodes fall records read out
+// of flash and batched acceleration packets, and prints the samples as CSV.
+//
+// Build:   cc -std=c99 -Wall -I. -I../logic -o codec_decode codec_decode.c
+//
+// Usage:   codec_decode record <file>     Fall record segment (FALL_RECORD_FLASH_START + n * 512),
+//                                          binary, 512 bytes
+//          codec_decode packets            Batched acceleration packets from stdin, one packet
+//                                          per line as hex bytes (with or without spaces)
+// *************************************************************************************************
+
+// *************************************************************************************************
+// Include section
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "project.h"
+#include "codec.h"
+
+
+// *************************************************************************************************
+// Defines section
+
+// Fall record header (logic/fall_recorder.h), little endian
+#define RECORD_MAGIC                    (0xFA12u)
+#define RECORD_HEADER_SIZE              (32u)
+#define RECORD_SIZE                     (512u)
+
+// Batched acceleration packet (logic/rfsimpliciti.h)
+#define PACKET_ACCEL_BATCH              (0x08u)
+#define PACKET_HEADER                   (4u)
+#define PACKET_SIZE                     (19u)
+
+
+// *************************************************************************************************
+// Global Variable section
+
+// Bit stream, most significant bit first
+struct reader
+{
+    const u8 *  buffer;
+    size_t      size;
+    size_t      bits;
+};
+
+
+// *************************************************************************************************
+// @fn          get_bits
+// @brief       Reads bits from the stream.
+// @param       struct reader * reader  Stream
+//              unsigned length         Number of bits (0..8)
+// @return      int                     Bits, right aligned. -1 = end of stream
+// *************************************************************************************************
+static int get_bits(struct reader * reader, unsigned length)
+{
+    int value = 0;
+
+    while (length--) {
+        if (reader->bits >= reader->size * 8) return (-1);
+        value = (value << 1) | ((reader->buffer[reader->bits >> 3] >> (7 - (reader->bits & 7))) & 1);
+        reader->bits++;
+    }
+    return (value);
+}
+
+
+// *************************************************************************************************
+// @fn          get_first
+// @brief       Reads the first sample of a channel.
+// @param       struct codec_channel * channel  Channel
+//              struct reader * reader          Stream
+// @return      int                             Sample, -1 = end of stream
+// *************************************************************************************************
+static int get_first(struct codec_channel * channel, struct reader * reader)
+{
+    int sample = get_bits(reader, 8);
+
+    if (sample < 0) return (-1);
+    channel->last  = (u8)sample;
+    channel->count = 1;
+    channel->sum   = 1 << CODEC_K_START;
+    return (sample);
+}
+
+
+// *************************************************************************************************
+// @fn          get_sample
+// @brief       Reads the next sample of a channel. Mirrors codec_put_sample().
+// @param       struct codec_channel * channel  Channel
+//              struct reader * reader          Stream
+// @return      int                             Sample, -1 = end of stream
+// *************************************************************************************************
+static int get_sample(struct codec_channel * channel, struct reader * reader)
+{
+    unsigned k = 0;
+    unsigned q = 0;
+    int bit, low, m;
+
+    while ((k < CODEC_K_MAX) && (((unsigned)channel->count << k) < channel->sum)) k++;
+
+    // Unary quotient, CODEC_ESCAPE ones are followed by the code value itself
+    while (q < CODEC_ESCAPE) {
+        if ((bit = get_bits(reader, 1)) < 0) return (-1);
+        if (bit == 0) break;
+        q++;
+    }
+    if (q == CODEC_ESCAPE) {
+        m = get_bits(reader, 8);
+    } else {
+        low = get_bits(reader, k);
+        m = (low < 0) ? -1 : (int)((q << k) | low);
+    }
+    if (m < 0 || m > 0xFF) return (-1);
+
+    // Code value 0, 1, 2, 3, ... is a difference of 0, -1, 1, -2, ...
+    channel->last = (u8)(channel->last + ((m & 1) ? ~(m >> 1) : (m >> 1)));
+    channel->sum += m;
+    if (++channel->count == CODEC_ADAPT_LIMIT) {
+        channel->count >>= 1;
+        channel->sum   >>= 1;
+    }
+    return (channel->last);
+}
+
+
+// codec_test.c includes this file up to here for the decoder
+#ifndef CODEC_DECODE_NO_MAIN
+
+// *************************************************************************************************
+// @fn          get_u16
+// @brief       Reads a little endian word (watch memory order).
+// @param       const u8 * data         Data
+// @return      unsigned                Word
+// *************************************************************************************************
+static unsigned get_u16(const u8 * data)
+{
+    return (data[0] | (data[1] << 8));
+}
+
+
+// *************************************************************************************************
+// @fn          decode_record
+// @brief       Prints the header and samples of a fall record.
+// @param       const char * name       Segment file
+// @return      int                     0 = ok
+// *************************************************************************************************
+static int decode_record(const char * name)
+{
+    u8 segment[RECORD_SIZE];
+    struct codec_channel channel;
+    struct reader reader;
+    unsigned samples, length, i;
+    int sample;
+    FILE * file;
+
+    if (!(file = fopen(name, "rb"))) {
+        perror(name);
+        return (1);
+    }
+    length = fread(segment, 1, sizeof(segment), file);
+    fclose(file);
+
+    if ((length < RECORD_HEADER_SIZE) || (get_u16(&segment[0]) != RECORD_MAGIC)) {
+        fprintf(stderr, "%s: no fall record\n", name);
+        return (1);
+    }
+
+    samples = get_u16(&segment[18]) + get_u16(&segment[20]);
+    printf("# sequence %u, %04u-%02u-%02u %02u:%02u:%02u\n", get_u16(&segment[2]),
+           get_u16(&segment[4]), segment[6], segment[7], segment[8], segment[9], segment[10]);
+    printf("# ratings %u %u %u %u, trigger %u, latency %u ms\n", segment[11], segment[12],
+           segment[13], segment[14], segment[15], get_u16(&segment[16]));
+    printf("# pre %u, post %u, rate %u Hz, candidate rate %u Hz from %u to %u\n",
+           get_u16(&segment[18]), get_u16(&segment[20]), segment[22], segment[23],
+           get_u16(&segment[24]), get_u16(&segment[26]));
+    if (segment[30] != 0xFF) {
+        printf("# height rating %u, drop %d dm\n", segment[30], (s8)segment[31]);
+    }
+
+    reader.buffer = &segment[RECORD_HEADER_SIZE];
+    reader.size   = get_u16(&segment[28]);
+    reader.bits   = 0;
+    if (reader.size > length - RECORD_HEADER_SIZE) reader.size = length - RECORD_HEADER_SIZE;
+
+    for (i = 0; i < samples; i++) {
+        sample = (i == 0) ? get_first(&channel, &reader) : get_sample(&channel, &reader);
+        if (sample < 0) {
+            fprintf(stderr, "%s: record ends after %u of %u samples\n", name, i, samples);
+            return (1);
+        }
+        printf("%u,%d\n", i, sample);
+    }
+    return (0);
+}
+
+
+// *************************************************************************************************
+// @fn          decode_packets
+// @brief       Prints the samples of batched acceleration packets read from stdin.
+// @param       none
+// @return      int                     0 = ok
+// *************************************************************************************************
+static int decode_packets(void)
+{
+    struct codec_channel channel[3];
+    struct reader reader;
+    char line[256];
+    u8 packet[PACKET_SIZE];
+    unsigned length, count, index, i, axis, line_number = 0;
+    int xyz[3];
+    char * p;
+    int result = 0;
+
+    while (fgets(line, sizeof(line), stdin)) {
+        line_number++;
+        length = 0;
+        for (p = line; *p && length < PACKET_SIZE; ) {
+            if (isxdigit((unsigned char)p[0]) && isxdigit((unsigned char)p[1])) {
+                char byte[3] = { p[0], p[1], 0 };
+                packet[length++] = (u8)strtoul(byte, 0, 16);
+                p += 2;
+            } else {
+                p++;
+            }
+        }
+        if (length == 0) continue;
+        if ((length < PACKET_HEADER) || !(packet[0] & PACKET_ACCEL_BATCH)) {
+            fprintf(stderr, "line %u: no batched acceleration packet\n", line_number);
+            result = 1;
+            continue;
+        }
+
+        count = packet[1];
+        index = (packet[2] << 8) | packet[3];
+        reader.buffer = &packet[PACKET_HEADER];
+        reader.size   = length - PACKET_HEADER;
+        reader.bits   = 0;
+
+        for (i = 0; i < count; i++) {
+            for (axis = 0; axis < 3; axis++) {
+                xyz[axis] = (i == 0) ? get_first(&channel[axis], &reader)
+                                     : get_sample(&channel[axis], &reader);
+                if (xyz[axis] < 0) break;
+            }
+            if (axis < 3) {
+                fprintf(stderr, "line %u: packet ends after %u of %u samples\n", line_number, i, count);
+                result = 1;
+                break;
+            }
+            // Samples are signed sensor values
+            printf("%u,%d,%d,%d\n", (index + i) & 0xFFFF, (s8)xyz[0], (s8)xyz[1], (s8)xyz[2]);
+        }
+    }
+    return (result);
+}
+
+
+int main(int argc, char * argv[])
+{
+    if ((argc == 3) && !strcmp(argv[1], "record")) return (decode_record(argv[2]));
+    if ((argc == 2) && !strcmp(argv[1], "packets")) return (decode_packets());
+
+    fprintf(stderr, "usage: %s record <file> | packets\n", argv[0]);
+    return (2);
+}
+#endif
@@ -0,0 +1,432 @@
+// *************************************************************************************************
+// Round trip host test for the sample codec. Samples are coded with the watch coder
+// (logic/codec.c) and decoded with the host decoder (host/codec_decode.c), the result must be
+// identical. Covers every sample pair at the escape and Rice parameter boundaries, the statistics
+// halving at CODEC_ADAPT_LIMIT, full streams, the chunked coding of the fall recorder and
+// synthetic acceleration traces (rest, walk, fall, full range noise).
+//
+// Build:   cc -std=c99 -Wall -O2 -I. -I../logic -o codec_test codec_test.c ../logic/codec.c
+//
+// Usage:   codec_test                      Built in cases
+//          codec_test <file> ...           Also round trips recorded traces: CSV lines with the
+//                                          signed x,y,z samples, optionally led by an index
+//                                          (output of codec_decode packets). The first
+//                                          TRACE_SIZE samples of each file are used.
+//
+//          Exit code 0 = all round trips identical
+// *************************************************************************************************
+
+// *************************************************************************************************
+// Include section
+#define CODEC_DECODE_NO_MAIN
+#include "codec_decode.c"
+
+
+// *************************************************************************************************
+// Defines section
+
+// Longest trace (samples per channel). Three channels of escapes still fit into one stream.
+#define TRACE_SIZE                      (1800u)
+
+// Largest stream, the writer counts bits in 16 bits
+#define STREAM_SIZE                     (8191u)
+
+// Chunk of the fall recorder (logic/fall_recorder.c)
+#define CHUNK_SIZE                      (32u)
+
+
+// *************************************************************************************************
+// Global Variable section
+static u8 trace[3][TRACE_SIZE];
+static u8 stream[STREAM_SIZE];
+static unsigned long errors;
+static unsigned long checks;
+
+
+// *************************************************************************************************
+// @fn          fail
+// @brief       Counts an error and prints the first ones.
+// @param       const char * what       Case
+//              unsigned index          Sample
+//              int result, expect      Result and expected value
+// @return      none
+// *************************************************************************************************
+static void fail(const char * what, unsigned index, int result, int expect)
+{
+    if (errors++ < 20) printf("%s: sample %u: %d, expected %d\n", what, index, result, expect);
+}
+
+
+// *************************************************************************************************
+// @fn          same_channel
+// @brief       Compares coder and decoder state of a channel.
+// @param       const struct codec_channel * a, * b     Channels
+// @return      int                                     1 = identical
+// *************************************************************************************************
+static int same_channel(const struct codec_channel * a, const struct codec_channel * b)
+{
+    return ((a->last == b->last) && (a->count == b->count) && (a->sum == b->sum));
+}
+
+
+// *************************************************************************************************
+// @fn          test_pairs
+// @brief       Codes every sample after every previous sample, for channel states at both sides
+//              of each Rice parameter step and just before the statistics are halved. Checks the
+//              decoded sample, the channel state, the code length and the escape boundary.
+// @param       none
+// @return      none
+// *************************************************************************************************
+static void test_pairs(void)
+{
+    static const u8 counts[] = { 1, 2, CODEC_ADAPT_LIMIT - 2, CODEC_ADAPT_LIMIT - 1 };
+    struct codec_channel coder, decoder, start;
+    struct codec_writer writer;
+    struct reader reader;
+    unsigned c, k, side, last, sample, bits, escapes = 0;
+    int result;
+    u8 buffer[4];
+
+    for (c = 0; c < sizeof(counts); c++) {
+        for (k = 0; k <= CODEC_K_MAX; k++) {
+            for (side = 0; side < 2; side++) {
+                // Sum at the upper end of k (count * 2^k) or just above it
+                start.count = counts[c];
+                start.sum   = ((u16)counts[c] << k) + side;
+                if (start.sum == 0) continue;
+
+                for (last = 0; last < 256; last++) {
+                    for (sample = 0; sample < 256; sample++) {
+                        start.last = (u8)last;
+                        coder = decoder = start;
+                        codec_start_writer(&writer, buffer, sizeof(buffer));
+                        bits = codec_sample_bits(&coder, (u8)sample);
+                        if (!codec_put_sample(&coder, &writer, (u8)sample)) {
+                            fail("pair not coded", sample, -1, (int)sample);
+                            continue;
+                        }
+                        if (writer.bits != bits) fail("pair code length", sample, writer.bits, bits);
+                        if (bits == CODEC_MAX_SAMPLE_BITS) escapes++;
+
+                        reader.buffer = buffer;
+                        reader.size   = sizeof(buffer);
+                        reader.bits   = 0;
+                        result = get_sample(&decoder, &reader);
+                        if (result != (int)sample) fail("pair", sample, result, sample);
+                        if (reader.bits != writer.bits) fail("pair bits read", sample, reader.bits, writer.bits);
+                        if (!same_channel(&coder, &decoder)) fail("pair channel state", sample, decoder.sum, coder.sum);
+                        checks++;
+                    }
+                }
+            }
+        }
+    }
+    if (escapes == 0) fail("no escape coded", 0, 0, 1);
+}
+
+
+// *************************************************************************************************
+// @fn          round_trip
+// @brief       Codes channels sample by sample interleaved like the acceleration packets, in
+//              chunks like the fall recorder, and decodes the bytes again.
+// @param       const char * what       Case
+//              unsigned channels       Number of channels (1..3)
+//              unsigned length         Samples per channel
+//              unsigned chunk          0 = one stream, else bytes taken out after each chunk
+// @return      unsigned                Coded bytes, 0 = error
+// *************************************************************************************************
+static unsigned round_trip(const char * what, unsigned channels, unsigned length, unsigned chunk)
+{
+    struct codec_channel coder[3], decoder[3];
+    struct codec_writer writer;
+    struct reader reader;
+    u8 buffer[CHUNK_SIZE + 8];
+    unsigned i, axis, out = 0, taken;
+    int result;
+
+    if (chunk) {
+        codec_start_writer(&writer, buffer, sizeof(buffer));
+    } else {
+        codec_start_writer(&writer, stream, sizeof(stream));
+    }
+
+    for (i = 0; i < length; i++) {
+        for (axis = 0; axis < channels; axis++) {
+            if (i == 0) {
+                result = codec_put_first(&coder[axis], &writer, trace[axis][i]);
+            } else {
+                result = codec_put_sample(&coder[axis], &writer, trace[axis][i]);
+            }
+            if (!result) {
+                fail(what, i, -1, trace[axis][i]);
+                return (0);
+            }
+        }
+        // Take out complete bytes once a chunk is full, keep the partial byte
+        if (chunk && ((writer.bits >> 3) >= chunk)) {
+            taken = writer.bits >> 3;
+            memcpy(&stream[out], buffer, taken);
+            out += taken;
+            codec_drop_bytes(&writer, taken);
+        }
+    }
+    if (chunk) {
+        memcpy(&stream[out], buffer, (writer.bits + 7) >> 3);
+        out += (writer.bits + 7) >> 3;
+    } else {
+        out = (writer.bits + 7) >> 3;
+    }
+
+    reader.buffer = stream;
+    reader.size   = out;
+    reader.bits   = 0;
+    for (i = 0; i < length; i++) {
+        for (axis = 0; axis < channels; axis++) {
+            result = (i == 0) ? get_first(&decoder[axis], &reader) : get_sample(&decoder[axis], &reader);
+            if (result != trace[axis][i]) {
+                fail(what, i, result, trace[axis][i]);
+                return (0);
+            }
+        }
+    }
+    checks += length * channels;
+    return (out);
+}
+
+
+// *************************************************************************************************
+// @fn          report
+// @brief       Round trips a trace in one stream and in recorder chunks, prints the code size.
+// @param       const char * what       Case
+//              unsigned length         Samples per channel
+// @return      none
+// *************************************************************************************************
+static void report(const char * what, unsigned length)
+{
+    unsigned bytes = round_trip(what, 3, length, 0);
+
+    round_trip(what, 1, length, CHUNK_SIZE);
+    if (bytes) printf("%-24s %5u samples, %5.2f bits per XYZ sample\n", what, length, (double)bytes * 8 / length);
+}
+
+
+// *************************************************************************************************
+// @fn          test_full_stream
+// @brief       Fills short streams (packet payloads) until the coder refuses a sample. The
+//              refused sample must leave the stream untouched and all accepted samples decode.
+// @param       none
+// @return      none
+// *************************************************************************************************
+static void test_full_stream(void)
+{
+    struct codec_channel coder, decoder;
+    struct codec_writer writer;
+    struct reader reader;
+    u8 buffer[15];
+    unsigned size, i, accepted, bits;
+    int result;
+
+    for (size = 1; size <= sizeof(buffer); size++) {
+        codec_start_writer(&writer, buffer, size);
+        if (!codec_put_first(&coder, &writer, trace[0][0])) {
+            fail("first sample refused", 0, -1, trace[0][0]);
+            continue;
+        }
+        for (accepted = 1; accepted < TRACE_SIZE; accepted++) {
+            bits = writer.bits;
+            if (!codec_put_sample(&coder, &writer, trace[0][accepted])) {
+                if (writer.bits != bits) fail("refused sample written", accepted, writer.bits, bits);
+                if (size * 8u - bits >= CODEC_MAX_SAMPLE_BITS) fail("sample refused with room", accepted, bits, size * 8);
+                break;
+            }
+            if (writer.bits > size * 8u) fail("stream overrun", accepted, writer.bits, size * 8);
+        }
+
+        reader.buffer = buffer;
+        reader.size   = size;
+        reader.bits   = 0;
+        for (i = 0; i < accepted; i++) {
+            result = (i == 0) ? get_first(&decoder, &reader) : get_sample(&decoder, &reader);
+            if (result != trace[0][i]) fail("full stream", i, result, trace[0][i]);
+        }
+        checks += accepted;
+    }
+}
+
+
+// *************************************************************************************************
+// @fn          next_random
+// @brief       Pseudo random numbers, same sequence on every host.
+// @param       none
+// @return      unsigned                15 random bits
+// *************************************************************************************************
+static unsigned next_random(void)
+{
+    static unsigned long state = 12345;
+
+    state = state * 1103515245ul + 12345ul;
+    return ((unsigned)(state >> 16) & 0x7FFF);
+}
+
+
+// *************************************************************************************************
+// @fn          noise
+// @brief       Random value in -range..range
+// @param       int range               Limit
+// @return      int                     Value
+// *************************************************************************************************
+static int noise(int range)
+{
+    return ((int)(next_random() % (2 * range + 1)) - range);
+}
+
+
+// *************************************************************************************************
+// @fn          clip
+// @brief       Limits a value to the signed 8-bit sensor range and stores it as raw sample.
+// @param       int value               Value
+// @return      u8                      Raw sample
+// *************************************************************************************************
+static u8 clip(int value)
+{
+    if (value > 127) value = 127;
+    if (value < -128) value = -128;
+    return ((u8)(s8)value);
+}
+
+
+// *************************************************************************************************
+// @fn          test_traces
+// @brief       Synthetic acceleration traces at the 2g range (about 18 mg/LSB, 1 g = 54).
+// @param       none
+// @return      none
+// *************************************************************************************************
+static void test_traces(void)
+{
+    unsigned i, axis;
+    int phase;
+
+    // Watch at rest on the wrist: gravity on one axis, sensor noise
+    for (i = 0; i < TRACE_SIZE; i++) {
+        trace[0][i] = clip(noise(1));
+        trace[1][i] = clip(-10 + noise(1));
+        trace[2][i] = clip(53 + noise(2));
+    }
+    report("rest", TRACE_SIZE);
+
+    // Walking: arm swing
+    for (i = 0; i < TRACE_SIZE; i++) {
+        phase = (int)(i % 100);
+        phase = (phase < 50) ? phase : 100 - phase;
+        trace[0][i] = clip(phase - 25 + noise(4));
+        trace[1][i] = clip(-20 + phase / 2 + noise(4));
+        trace[2][i] = clip(45 - phase / 3 + noise(6));
+    }
+    report("walk", TRACE_SIZE);
+
+    // Falls: rest, free fall to 0 g, impact at full scale, lying still
+    for (i = 0; i < TRACE_SIZE; i++) {
+        phase = (int)(i % 400);
+        for (axis = 0; axis < 3; axis++) {
+            if (phase < 200) {
+                trace[axis][i] = clip((axis == 2 ? 53 : 0) + noise(2));
+            } else if (phase < 240) {
+                trace[axis][i] = clip(noise(3));
+            } else if (phase < 250) {
+                trace[axis][i] = clip(((phase & 1) ? 127 : -128) + noise(10));
+            } else {
+                trace[axis][i] = clip((axis == 0 ? -53 : 0) + noise(2));
+            }
+        }
+    }
+    report("fall", TRACE_SIZE);
+
+    // Full range noise: mostly escapes
+    for (i = 0; i < TRACE_SIZE; i++) {
+        for (axis = 0; axis < 3; axis++) trace[axis][i] = (u8)next_random();
+    }
+    report("full range noise", TRACE_SIZE);
+
+    // Largest steps: wrap around between the ends of the sample range
+    for (i = 0; i < TRACE_SIZE; i++) {
+        trace[0][i] = (i & 1) ? 0x7F : 0x80;
+        trace[1][i] = (i & 1) ? 0x00 : 0xFF;
+        trace[2][i] = (u8)(i * 128);
+    }
+    report("largest steps", TRACE_SIZE);
+
+    // Constant channel, then a single escape after the statistics adapted to k = 0
+    for (i = 0; i < TRACE_SIZE; i++) {
+        for (axis = 0; axis < 3; axis++) trace[axis][i] = (i == 1000) ? 0x80 : 0x10;
+    }
+    report("constant with one step", TRACE_SIZE);
+
+    // Lengths around the statistics halving
+    for (i = CODEC_ADAPT_LIMIT - 2; i <= 2 * CODEC_ADAPT_LIMIT + 2; i++) {
+        round_trip("short trace", 3, i, 0);
+    }
+
+    // Stream tests: alternating steps growing into the escape range within a packet
+    trace[0][0] = 0;
+    for (i = 1; i < TRACE_SIZE; i++) trace[0][i] = (u8)(trace[0][i - 1] + ((i & 1) ? 1 : -1) * (int)(i * 7));
+    test_full_stream();
+}
+
+
+// *************************************************************************************************
+// @fn          test_file
+// @brief       Round trips a recorded trace.
+// @param       const char * name       CSV file
+// @return      int                     0 = file read
+// *************************************************************************************************
+static int test_file(const char * name)
+{
+    char line[256];
+    int value[4];
+    unsigned length = 0;
+    int fields;
+    FILE * file;
+
+    if (!(file = fopen(name, "r"))) {
+        perror(name);
+        return (1);
+    }
+    while (fgets(line, sizeof(line), file) && (length < TRACE_SIZE)) {
+        if (line[0] == '#') continue;
+        fields = sscanf(line, "%d,%d,%d,%d", &value[0], &value[1], &value[2], &value[3]);
+        if (fields < 3) continue;
+        trace[0][length] = (u8)value[fields - 3];
+        trace[1][length] = (u8)value[fields - 2];
+        trace[2][length] = (u8)value[fields - 1];
+        length++;
+    }
+    fclose(file);
+
+    if (length == 0) {
+        fprintf(stderr, "%s: no samples\n", name);
+        return (1);
+    }
+    report(name, length);
+    return (0);
+}
+
+
+// *************************************************************************************************
+// @fn          main
+// @brief       Runs all cases and reports the first mismatches.
+// @param       int argc, char * argv[] Recorded traces
+// @return      int                     0 = pass, 1 = fail
+// *************************************************************************************************
+int main(int argc, char * argv[])
+{
+    int i;
+
+    test_pairs();
+    test_traces();
+    for (i = 1; i < argc; i++) {
+        if (test_file(argv[i])) errors++;
+    }
+
+    printf("%lu samples round tripped, %lu errors\n", checks, errors);
+    return (errors != 0);
+}
@@ -0,0 +1,78 @@
+// *************************************************************************************************
+// Exhaustive host test for the integer magnitude kernel of the fall detection (logic/magnitude.c).
+// Checks isqrt16() for all 2^16 radicands and acc_magnitude() for all 2^24 raw XYZ triples
+// against the truncating (u16)sqrt() of the floating point code it replaced.
+//
+// Build:   cc -std=c99 -Wall -O2 -I. -I../logic -o magnitude_test magnitude_test.c ../logic/magnitude.c -lm
+//
+// Usage:   magnitude_test                  Exit code 0 = all results exact
+// *************************************************************************************************
+
+// *************************************************************************************************
+// Include section
+#include <stdio.h>
+#include <math.h>
+
+#include "project.h"
+#include "magnitude.h"
+
+
+// *************************************************************************************************
+// @fn          reference
+// @brief       Result of the replaced code: (u16)sqrt(x^2 + y^2 + z^2) of the signed raw axes.
+// @param       u8 x, y, z  Raw acceleration data from sensor
+// @return      unsigned    Truncated magnitude
+// *************************************************************************************************
+static unsigned reference(u8 x, u8 y, u8 z)
+{
+    long sum = (long)(s8)x * (s8)x + (long)(s8)y * (s8)y + (long)(s8)z * (s8)z;
+
+    return ((unsigned)(u16)sqrt((double)sum));
+}
+
+
+// *************************************************************************************************
+// @fn          main
+// @brief       Runs both checks and reports the first mismatches.
+// @param       none
+// @return      int         0 = pass, 1 = fail
+// *************************************************************************************************
+int main(void)
+{
+    unsigned long errors = 0;
+    unsigned long value;
+    unsigned x, y, z;
+    unsigned expect, result;
+    unsigned max = 0;
+
+    for (value = 0; value <= 0xFFFFu; value++) {
+        result = isqrt16((u16)value);
+        if ((result * result > value) || ((result + 1) * (result + 1) <= value)) {
+            if (errors++ < 10) printf("isqrt16(%lu) = %u\n", value, result);
+        }
+    }
+
+    for (x = 0; x < 256; x++) {
+        for (y = 0; y < 256; y++) {
+            for (z = 0; z < 256; z++) {
+                expect = reference(x, y, z);
+                result = acc_magnitude(x, y, z);
+                if (result != expect) {
+                    if (errors++ < 20) {
+                        printf("acc_magnitude(%d, %d, %d) = %u, expected %u\n",
+                               (s8)x, (s8)y, (s8)z, result, expect);
+                    }
+                }
+                if (result > max) max = result;
+            }
+        }
+    }
+
+    if (max != ACC_MAGNITUDE_MAX) {
+        printf("largest magnitude %u, ACC_MAGNITUDE_MAX is %u\n", max, ACC_MAGNITUDE_MAX);
+        errors++;
+    }
+
+    printf("isqrt16: 65536 radicands, acc_magnitude: 16777216 triples, %lu errors\n", errors);
+    return (errors != 0);
+}
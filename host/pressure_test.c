@@ -0,0 +1,236 @@
+// *************************************************************************************************
+// Host test for the fixed point altitude conversion (driver/pressure_table.c). Compares
+// conv_pa_to_meter() and update_pressure_table() against the VTI floating point reference they
+// replaced, over 30000-120000 Pa and 200-330 K, for the default table and for calibrations
+// from -100 m to 9000 m at the standard pressure +-5 % and 230/288/320 K.
+//
+// Build:   cc -std=c99 -Wall -O2 -I. -I../driver -o pressure_test pressure_test.c ../driver/pressure_table.c -lm
+//
+// Usage:   pressure_test                   Exit code 0 = all errors within the bounds
+// *************************************************************************************************
+
+// *************************************************************************************************
+// Include section
+#include <stdio.h>
+#include <math.h>
+
+#include "project.h"
+#include "vti_ps.h"
+
+
+// *************************************************************************************************
+// Defines section
+
+// Error bounds. The altitude is rounded to 1 m, which alone gives 0.5 m. The calibration
+// truncates its integer divisions, the table entries stay within 3 Pa. Pressures outside the table are extrapolated from the outer interval, up
+// to 5 km for a table calibrated at 9000 m, which amplifies the rounding of the table entries.
+#define ERROR_BOUND_TABLE               (1.0)
+#define ERROR_BOUND_EXTRAPOLATED        (3.0)
+#define ERROR_BOUND_PA                  (3.0)
+
+// Sweep
+#define PA_MIN                          (30000ul)
+#define PA_MAX                          (120000ul)
+#define PA_STEP                         (25ul)
+#define T_MIN                           (2000u)
+#define T_MAX                           (3300u)
+#define T_STEP                          (5u)
+
+
+// *************************************************************************************************
+// Global Variable section
+
+// Tables of the fixed point code (driver/pressure_table.c)
+extern const s16 h0[17];
+extern const u16 p0[17];
+extern u32 p[17];
+
+// Pressure table (hPa) of the reference
+static double ref_p[17];
+
+// Largest errors
+struct error
+{
+    double      max;
+    u32         p_meas;
+    u16         t_meas;
+    s16         href;
+};
+
+
+// *************************************************************************************************
+// @fn          ref_init_pressure_table
+// @brief       Reference of init_pressure_table().
+// @param       none
+// @return      none
+// *************************************************************************************************
+static void ref_init_pressure_table(void)
+{
+    unsigned i;
+
+    for (i = 0; i < 17; i++) ref_p[i] = p0[i];
+}
+
+
+// *************************************************************************************************
+// @fn          ref_update_pressure_table
+// @brief       Reference of update_pressure_table(): the VTI floating point code, in double.
+// @param       s16 href                Reference height (m)
+//              u32 p_meas              Pressure (Pa)
+//              u16 t_meas              Temperature (10*K)
+// @return      none
+// *************************************************************************************************
+static void ref_update_pressure_table(s16 href, u32 p_meas, u16 t_meas)
+{
+    const double Invt00 = 0.003470415;
+    const double coefp  = 0.00006;
+    double p_fact, p_noll, hnoll, h_low = 0, t0;
+    unsigned i;
+
+    t0 = t_meas / 10.0 + 0.0065 * href;
+    hnoll = href / (t0 * Invt00);
+
+    for (i = 0; i <= 15; i++) {
+        if (h0[i] > hnoll) break;
+        h_low = h0[i];
+    }
+    p_noll = (hnoll - h_low) * (1 - (hnoll - h0[i]) * coefp) * ((double)p0[i] - p0[i - 1]) / (h0[i] - h_low) + p0[i - 1];
+
+    p_fact = p_meas / 100.0 / p_noll;
+    for (i = 0; i <= 16; i++) ref_p[i] = p0[i] * p_fact;
+}
+
+
+// *************************************************************************************************
+// @fn          ref_conv_pa_to_meter
+// @brief       Reference of conv_pa_to_meter(): the VTI floating point code, in double and
+//              without truncation of the result. Includes the fix of the first interval, where
+//              the VTI code dropped the h0[0] offset.
+// @param       u32 p_meas              Pressure (Pa)
+//              u16 t_meas              Temperature (10*K)
+// @return      double                  Altitude (m)
+// *************************************************************************************************
+static double ref_conv_pa_to_meter(u32 p_meas, u16 t_meas)
+{
+    const double coef2  = 0.0007;
+    const double Invt00 = 0.003470415;
+    double hnoll, t0, p_low = 0;
+    double fl_p_meas = p_meas / 100.0;
+    double fl_t_meas = t_meas / 10.0;
+    unsigned i;
+
+    for (i = 0; i <= 16; i++) {
+        if (ref_p[i] < fl_p_meas) break;
+        p_low = ref_p[i];
+    }
+
+    if (i == 0) {
+        hnoll = (fl_p_meas - ref_p[0]) / (ref_p[1] - ref_p[0]) * (h0[1] - h0[0]) + h0[0];
+    } else if (i < 15) {
+        hnoll = (fl_p_meas - p_low) * (1 - (fl_p_meas - ref_p[i]) * coef2) / (ref_p[i] - p_low) * (h0[i] - h0[i - 1]) + h0[i - 1];
+    } else if (i == 15) {
+        hnoll = (fl_p_meas - p_low) / (ref_p[i] - p_low) * (h0[i] - h0[i - 1]) + h0[i - 1];
+    } else {
+        hnoll = (fl_p_meas - ref_p[16]) / (ref_p[16] - ref_p[15]) * (h0[16] - h0[15]) + h0[16];
+    }
+
+    t0 = fl_t_meas / (1 - hnoll * Invt00 * 0.0065);
+    return (Invt00 * t0 * hnoll);
+}
+
+
+// *************************************************************************************************
+// @fn          sweep
+// @brief       Converts the whole pressure and temperature range with the current tables.
+// @param       s16 href                Reference height of the tables (for the report)
+//              struct error * table    Largest error inside the pressure table
+//              struct error * outside  Largest error of extrapolated pressures
+// @return      none
+// *************************************************************************************************
+static void sweep(s16 href, struct error * table, struct error * outside)
+{
+    struct error * error;
+    double e;
+    u32 p_meas;
+    u16 t_meas;
+
+    for (p_meas = PA_MIN; p_meas <= PA_MAX; p_meas += PA_STEP) {
+        error = ((p_meas <= p[0]) && (p_meas >= p[16])) ? table : outside;
+        for (t_meas = T_MIN; t_meas <= T_MAX; t_meas += T_STEP) {
+            e = fabs(conv_pa_to_meter(p_meas, t_meas) - ref_conv_pa_to_meter(p_meas, t_meas));
+            if (e > error->max) {
+                error->max    = e;
+                error->p_meas = p_meas;
+                error->t_meas = t_meas;
+                error->href   = href;
+            }
+        }
+    }
+}
+
+
+// *************************************************************************************************
+// @fn          check
+// @brief       Prints the largest error and checks it against the bound.
+// @param       const char * what       Case
+//              const struct error * error  Largest error
+//              double bound            Error bound (m)
+// @return      int                     1 = bound exceeded
+// *************************************************************************************************
+static int check(const char * what, const struct error * error, double bound)
+{
+    printf("%-36s max error %5.2f m (%lu Pa, %.1f K, calibrated at %d m), bound %.1f m\n", what,
+           error->max, (unsigned long)error->p_meas, error->t_meas / 10.0, error->href, bound);
+    return (error->max > bound);
+}
+
+
+// *************************************************************************************************
+// @fn          main
+// @brief       Sweeps the default table and all calibrations.
+// @param       none
+// @return      int                     0 = pass, 1 = fail
+// *************************************************************************************************
+int main(void)
+{
+    static const s16 heights[] = { -100, 0, 100, 500, 1000, 2000, 3000, 4000, 5000, 6000, 7000, 8000, 9000 };
+    static const u16 temperatures[] = { 2300, 2880, 3200 };
+    static const int offsets[] = { -5, 0, 5 };
+    struct error table = { 0 }, outside = { 0 };
+    double standard, e, max_pa = 0;
+    unsigned h, t, o, i;
+    u32 p_meas;
+    int errors = 0;
+
+    init_pressure_table();
+    ref_init_pressure_table();
+    sweep(0, &table, &outside);
+    errors += check("default table, inside", &table, ERROR_BOUND_TABLE);
+    errors += check("default table, extrapolated", &outside, ERROR_BOUND_EXTRAPOLATED);
+
+    // Calibrations at the standard pressure of each height and +-5 %
+    table.max = outside.max = 0;
+    for (h = 0; h < sizeof(heights) / sizeof(heights[0]); h++) {
+        standard = 101325.0 * pow(1 - 0.0065 * heights[h] / 288.15, 5.255);
+        for (o = 0; o < sizeof(offsets) / sizeof(offsets[0]); o++) {
+            for (t = 0; t < sizeof(temperatures) / sizeof(temperatures[0]); t++) {
+                p_meas = (u32)(standard * (100 + offsets[o]) / 100);
+                update_pressure_table(heights[h], p_meas, temperatures[t]);
+                ref_update_pressure_table(heights[h], p_meas, temperatures[t]);
+
+                for (i = 0; i < 17; i++) {
+                    e = fabs(p[i] - ref_p[i] * 100);
+                    if (e > max_pa) max_pa = e;
+                }
+                sweep(heights[h], &table, &outside);
+            }
+        }
+    }
+    errors += check("calibrated tables, inside", &table, ERROR_BOUND_TABLE);
+    errors += check("calibrated tables, extrapolated", &outside, ERROR_BOUND_EXTRAPOLATED);
+    printf("%-36s max error %5.2f Pa, bound %.1f Pa\n", "calibrated table entries", max_pa, ERROR_BOUND_PA);
+    errors += (max_pa > ERROR_BOUND_PA);
+
+    printf("%d errors\n", errors);
+    return (errors != 0);
+}
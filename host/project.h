@@ -0,0 +1,39 @@
+// *************************************************************************************************
+// Host stand-in for include/project.h. Provides the watch types and bit masks, so that the
+// hardware independent logic files can be compiled into the host tests in this directory.
+// *************************************************************************************************
+
+#ifndef PROJECT_H_
+#define PROJECT_H_
+
+// *************************************************************************************************
+// Include section
+#include <stdint.h>
+
+
+// *************************************************************************************************
+// Typedef section
+
+// Watch types (bluerobin/bm.h)
+typedef uint8_t         u8;
+typedef int8_t          s8;
+typedef uint16_t        u16;
+typedef int16_t         s16;
+typedef uint32_t        u32;
+typedef int32_t         s32;
+
+
+// *************************************************************************************************
+// Defines section
+
+#define BIT0            (0x0001u)
+#define BIT1            (0x0002u)
+#define BIT2            (0x0004u)
+#define BIT3            (0x0008u)
+#define BIT4            (0x0010u)
+#define BIT5            (0x0020u)
+#define BIT6            (0x0040u)
+#define BIT7            (0x0080u)
+
+
+#endif /*PROJECT_H_*/
@@ -54,6 +54,20 @@
 // Comment this define to build the application without bluerobin support and related functionality
 //#define USE_BLUEROBIN
 
+// Uncomment this define to send codec coded batches of acceleration samples per SimpliciTI packet
+// (SIMPLICITI_ACCEL_BATCH, decoded by host/codec_decode.c). The stock access point and Chronos 
+// Control Center only parse one sample per packet.
+//#define USE_SIMPLICITI_ACCEL_BATCH
+
+// Uncomment this define to broadcast fall alerts the access point did not acknowledge on the link.
+// Needs a listener that replies with SIMPLICITI_BROADCAST_ACK, the stock access point does not.
+//#define USE_SIMPLICITI_BROADCAST_ALERT
+
+// Uncomment this define to raise DRDY_PROBE_PIN while PORT2_ISR services a sensor DRDY interrupt
+// and while DMA_ISR runs. The delay from the DRDY edge to the probe edge is the DRDY service latency,
+// the summed pulse widths are the CPU time per acceleration sample (scope measurement).
+//#define USE_DRDY_LATENCY_PROBE
+
 // Use/not use filter when measuring physical values
 #define FILTER_OFF						(0u)
 #define FILTER_ON						(1u)
@@ -91,29 +105,12 @@ typedef union
     u16 up_down_repeat_enabled  : 1;    // While in set_value(), create virtual UP/DOWN button events
     u16 low_battery      		: 1;    // 1 = Battery is low
     u16 use_metric_units		: 1;    // 1 = Use metric units, 0 = use English units
-    u16 delay_over     			: 1;    // 1 = Timer delay over
   } flag;
   u16 all_flags;            // Shortcut to all display flags (for reset)
 } s_system_flags;
 extern volatile s_system_flags sys;
 
 
-// Set of request flags
-typedef union
-{
-  struct
-  {
-    u16 temperature_measurement 	: 1;    // 1 = Measure temperature
-    u16 voltage_measurement    		: 1;    // 1 = Measure voltage
-    u16 altitude_measurement    	: 1;    // 1 = Measure air pressure
-    u16	acceleration_measurement	: 1; 	// 1 = Measure acceleration
-    u16 buzzer      				: 1;    // 1 = Output buzzer
-  } flag;
-  u16 all_flags;            // Shortcut to all display flags (for reset)
-} s_request_flags;
-extern volatile s_request_flags request;
-
-
 // Set of message flags
 typedef union
 {
@@ -37,7 +37,9 @@ MEMORY
     INFOB                   : origin = 0x1900, length = 0x0080
     INFOC                   : origin = 0x1880, length = 0x0080
     INFOD                   : origin = 0x1800, length = 0x0080
-    FLASH                   : origin = 0x8000, length = 0x7F80
+    FALL_LOG                : origin = 0x8000, length = 0x0800
+    DATA_LOG                : origin = 0x8800, length = 0x0800
+    FLASH                   : origin = 0x9000, length = 0x6F80
     INT00                   : origin = 0xFF80, length = 0x0002
     INT01                   : origin = 0xFF82, length = 0x0002
     INT02                   : origin = 0xFF84, length = 0x0002
@@ -50,6 +50,7 @@
 #include "timer.h"
 
 // logic
+#include "fall_height.h"
 #include "user.h"
 
 
@@ -168,14 +169,23 @@ void start_altitude_measurement(void)
 		PS_INT_IFG &= ~PS_INT_PIN;
 		PS_INT_IE |= PS_INT_PIN;
 
-		// Start pressure sensor
-		ps_start(); 
+		// Start pressure sensor, unless the fall detector samples a candidate
+		if (!is_fall_height_candidate()) ps_start(PS_MODE_ULTRA_LOW_POWER);
 
 		// Set timeout counter only if sensor status was OK
 		sAlt.timeout = ALTITUDE_MEASUREMENT_TIMEOUT;
 
+		// Wait in LPM3 for the first sample, DRDY IRQ wakes up CPU
+		// Interrupts are disabled between pin check and sleep, so DRDY cannot be missed
+		__disable_interrupt();
+		while ((PS_INT_IN & PS_INT_PIN) == 0)
+		{
+			_BIS_SR(LPM3_bits + GIE);
+			__disable_interrupt();
+		}
+		__enable_interrupt();
+
 		// Get updated altitude
-		while((PS_INT_IN & PS_INT_PIN) == 0); 
 		do_altitude_measurement(FILTER_OFF);
 	}
 }
@@ -192,12 +202,20 @@ void stop_altitude_measurement(void)
 	// Return if pressure sensor was not initialised properly
 	if (!ps_ok) return;
 	
-	// Stop pressure sensor
-	ps_stop();
+	// Sensor is stopped by the fall detector when its candidate is done
+	if (!is_fall_height_candidate())
+	{
+		// Stop pressure sensor
+		ps_stop();
+	}
 	
-	// Disable DRDY IRQ
-	PS_INT_IE  &= ~PS_INT_PIN;
-	PS_INT_IFG &= ~PS_INT_PIN;
+	// Fall detector keeps the DRDY IRQ for its single conversions
+	if (!is_fall_height_measurement())
+	{
+		// Disable DRDY IRQ
+		PS_INT_IE  &= ~PS_INT_PIN;
+		PS_INT_IFG &= ~PS_INT_PIN;
+	}
 	
 	// Clear timeout counter
 	sAlt.timeout = 0;
@@ -213,16 +231,31 @@ void stop_altitude_measurement(void)
 // *************************************************************************************************
 void do_altitude_measurement(u8 filter)
 {
-	volatile u32 pressure;
+	u32 pressure;
+	u16 temperature;
 
 	// If sensor is not ready, skip data read	
 	if ((PS_INT_IN & PS_INT_PIN) == 0) return;
 		
-	// Get temperature (format is *10K) from sensor
-	sAlt.temperature = ps_get_temp();
+	// Get pressure (format is 1Pa) and temperature (format is *10K) from sensor
+	if (!ps_get_pa_temp(&pressure, &temperature)) return;
+	
+	update_altitude(pressure, temperature, filter);
+}
 
-	// Get pressure (format is 1Pa) from sensor
-	pressure = ps_get_pa();	
+
+// *************************************************************************************************
+// @fn          update_altitude
+// @brief       Calculate altitude from a pressure sample. Also called by the fall detector, which
+//				reads the samples while it monitors the pressure.
+// @param       u32 pressure		Pressure (Pa)
+//				u16 temperature		Temperature (10*K)
+//				u8 filter			FILTER_ON, FILTER_OFF
+// @return      none
+// *************************************************************************************************
+void update_altitude(u32 pressure, u16 temperature, u8 filter)
+{
+	sAlt.temperature = temperature;
 		
 	// Store measured pressure value
 	if (filter == FILTER_OFF) //sAlt.pressure == 0) 
@@ -231,8 +264,8 @@ void do_altitude_measurement(u8 filter)
 	}
 	else
 	{
-		// Filter current pressure
-		pressure = (u32)((pressure * 0.2) + (sAlt.pressure * 0.8));
+		// Filter current pressure: 0.2 * new + 0.8 * average
+		pressure = (pressure + 4 * sAlt.pressure) / 5;
 	
 		// Store average pressure
 		sAlt.pressure = pressure;
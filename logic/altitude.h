@@ -48,6 +48,7 @@ extern u8 is_altitude_measurement(void);
 extern void start_altitude_measurement(void);
 extern void stop_altitude_measurement(void);
 extern void do_altitude_measurement(u8 filter);
+extern void update_altitude(u32 pressure, u16 temperature, u8 filter);
 
 // menu functions
 extern void sx_altitude(u8 line);
@@ -56,6 +56,7 @@
 // Prototypes section
 void reset_batt_measurement(void);
 void battery_measurement(void);
+void store_battery_voltage(u16 voltage);
 
 
 // *************************************************************************************************
@@ -93,18 +94,25 @@ void reset_batt_measurement(void)
 
 // *************************************************************************************************
 // @fn          battery_measurement
-// @brief       Init ADC12. Do single conversion of AVCC voltage. Turn off ADC12.
+// @brief       Queue a conversion of AVCC voltage. The result is stored by store_battery_voltage().
 // @param       none
 // @return      none
 // *************************************************************************************************
 void battery_measurement(void)
 {
-	u16 voltage;
-	
 	// Convert external battery voltage (ADC12INCH_11=AVCC-AVSS/2)
-	//voltage = adc12_single_conversion(REFVSEL_2, ADC12SHT0_10, ADC12SSEL_0, ADC12SREF_1, ADC12INCH_11, ADC12_BATT_CONVERSION_TIME_USEC);
-	voltage = adc12_single_conversion(REFVSEL_1, ADC12SHT0_10, ADC12INCH_11);
+	adc12_request_conversion(ADC12INCH_11, store_battery_voltage);
+}
 
+
+// *************************************************************************************************
+// @fn          store_battery_voltage
+// @brief       Convert, filter and store an AVCC conversion result.
+// @param       u16 voltage		ADC12 result of channel 11
+// @return      none
+// *************************************************************************************************
+void store_battery_voltage(u16 voltage)
+{
 	// Convert ADC value to "x.xx V"
 	// Ideally we have A11=0->AVCC=0V ... A11=4095(2^12-1)->AVCC=4V
 	// --> (A11/4095)*4V=AVCC --> AVCC=(A11*4)/4095
@@ -47,6 +47,7 @@
 // Internal functions
 extern void reset_batt_measurement(void);
 extern void battery_measurement(void);
+extern void store_battery_voltage(u16 voltage);
 
 // Menu functions
 extern void display_battery_V(u8 line, u8 update);
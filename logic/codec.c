@@ -0,0 +1,181 @@
+// *************************************************************************************************
+// Lossless sample codec. Differences of consecutive 8-bit samples are Rice coded with a parameter
+// that adapts to the recent differences of each channel. Used for the fall records in flash and
+// the acceleration stream. The matching decoder for the host is host/codec_decode.c.
+// *************************************************************************************************
+
+// *************************************************************************************************
+// Include section
+
+// system
+#include "project.h"
+#include <string.h>
+
+// logic
+#include "codec.h"
+
+
+// *************************************************************************************************
+// @fn          codec_map
+// @brief       Maps the difference to the previous sample to a code value: 0, -1, 1, -2, ...
+//              become 0, 1, 2, 3, ...
+// @param       const struct codec_channel * channel    Channel
+//              u8 sample                               New sample
+// @return      u8                                      Code value
+// *************************************************************************************************
+u8 codec_map(const struct codec_channel * channel, u8 sample)
+{
+    s8 delta = (s8)(sample - channel->last);
+
+    return ((delta >= 0) ? ((u8)delta << 1) : ((u8)(~delta) << 1) | 1);
+}
+
+
+// *************************************************************************************************
+// @fn          codec_k
+// @brief       Rice parameter of a channel: smallest k with count * 2^k >= sum.
+// @param       const struct codec_channel * channel    Channel
+// @return      u8                                      Rice parameter
+// *************************************************************************************************
+u8 codec_k(const struct codec_channel * channel)
+{
+    u8 k = 0;
+
+    while ((k < CODEC_K_MAX) && (((u16)channel->count << k) < channel->sum)) k++;
+    return (k);
+}
+
+
+// *************************************************************************************************
+// @fn          codec_put_bits
+// @brief       Appends bits to the stream.
+// @param       struct codec_writer * writer            Stream
+//              u8 value                                Bits, right aligned
+//              u8 length                               Number of bits (0..8)
+// @return      none
+// *************************************************************************************************
+void codec_put_bits(struct codec_writer * writer, u8 value, u8 length)
+{
+    u8 mask;
+
+    while (length--) {
+        mask = 0x80 >> (writer->bits & 7);
+        if (mask == 0x80) writer->buffer[writer->bits >> 3] = 0;
+        if (value & (1 << length)) writer->buffer[writer->bits >> 3] |= mask;
+        writer->bits++;
+    }
+}
+
+
+// *************************************************************************************************
+// @fn          codec_start_writer
+// @brief       Start a bit stream.
+// @param       struct codec_writer * writer            Stream
+//              u8 * buffer                             Buffer for the coded bytes
+//              u16 size                                Buffer size (bytes)
+// @return      none
+// *************************************************************************************************
+void codec_start_writer(struct codec_writer * writer, u8 * buffer, u16 size)
+{
+    writer->buffer = buffer;
+    writer->size   = size;
+    writer->bits   = 0;
+}
+
+
+// *************************************************************************************************
+// @fn          codec_put_first
+// @brief       Start a channel with its first sample. The sample is sent in 8 bits.
+// @param       struct codec_channel * channel          Channel
+//              struct codec_writer * writer            Stream
+//              u8 sample                               First sample
+// @return      u8                                      1 = sample sent, 0 = stream is full
+// *************************************************************************************************
+u8 codec_put_first(struct codec_channel * channel, struct codec_writer * writer, u8 sample)
+{
+    if (codec_writer_free(writer) < 8) return (0);
+
+    codec_put_bits(writer, sample, 8);
+    channel->last  = sample;
+    channel->count = 1;
+    channel->sum   = 1 << CODEC_K_START;
+    return (1);
+}
+
+
+// *************************************************************************************************
+// @fn          codec_sample_bits
+// @brief       Length of the code of a sample.
+// @param       const struct codec_channel * channel    Channel
+//              u8 sample                               Sample
+// @return      u8                                      Bits
+// *************************************************************************************************
+u8 codec_sample_bits(const struct codec_channel * channel, u8 sample)
+{
+    u8 k = codec_k(channel);
+    u8 q = codec_map(channel, sample) >> k;
+
+    return ((q < CODEC_ESCAPE) ? (q + 1u + k) : CODEC_MAX_SAMPLE_BITS);
+}
+
+
+// *************************************************************************************************
+// @fn          codec_put_sample
+// @brief       Code a sample if it fits into the stream.
+// @param       struct codec_channel * channel          Channel
+//              struct codec_writer * writer            Stream
+//              u8 sample                               Sample
+// @return      u8                                      1 = sample coded, 0 = stream is full
+// *************************************************************************************************
+u8 codec_put_sample(struct codec_channel * channel, struct codec_writer * writer, u8 sample)
+{
+    u8 k = codec_k(channel);
+    u8 m = codec_map(channel, sample);
+    u8 q = m >> k;
+
+    if (codec_sample_bits(channel, sample) > codec_writer_free(writer)) return (0);
+
+    if (q < CODEC_ESCAPE) {
+        while (q--) codec_put_bits(writer, 1, 1);
+        codec_put_bits(writer, 0, 1);
+        codec_put_bits(writer, m, k);
+    } else {
+        codec_put_bits(writer, 0xFF, CODEC_ESCAPE);
+        codec_put_bits(writer, m, 8);
+    }
+
+    channel->last = sample;
+    channel->sum += m;
+    if (++channel->count == CODEC_ADAPT_LIMIT) {
+        channel->count >>= 1;
+        channel->sum   >>= 1;
+    }
+    return (1);
+}
+
+
+// *************************************************************************************************
+// @fn          codec_writer_free
+// @brief       Free space of a stream.
+// @param       const struct codec_writer * writer      Stream
+// @return      u16                                     Bits
+// *************************************************************************************************
+u16 codec_writer_free(const struct codec_writer * writer)
+{
+    return ((writer->size << 3) - writer->bits);
+}
+
+
+// *************************************************************************************************
+// @fn          codec_drop_bytes
+// @brief       Removes complete bytes from the start of the stream, e.g. after they have been
+//              programmed. The rest of the stream moves to the start of the buffer.
+// @param       struct codec_writer * writer            Stream
+//              u16 length                              Bytes to remove (complete bytes only)
+// @return      none
+// *************************************************************************************************
+void codec_drop_bytes(struct codec_writer * writer, u16 length)
+{
+    memmove(writer->buffer, writer->buffer + length, ((writer->bits + 7) >> 3) - length);
+    writer->bits -= length << 3;
+}
@@ -0,0 +1,65 @@
+// *************************************************************************************************
+
+#ifndef CODEC_H_
+#define CODEC_H_
+
+
+// *************************************************************************************************
+// Include section
+
+
+// *************************************************************************************************
+// Prototypes section
+struct codec_channel;
+struct codec_writer;
+extern void codec_start_writer(struct codec_writer * writer, u8 * buffer, u16 size);
+extern u8 codec_put_first(struct codec_channel * channel, struct codec_writer * writer, u8 sample);
+extern u8 codec_sample_bits(const struct codec_channel * channel, u8 sample);
+extern u8 codec_put_sample(struct codec_channel * channel, struct codec_writer * writer, u8 sample);
+extern u16 codec_writer_free(const struct codec_writer * writer);
+extern void codec_drop_bytes(struct codec_writer * writer, u16 length);
+
+
+// *************************************************************************************************
+// Defines section
+
+// The first sample of a channel is sent in 8 bits. Following samples are coded as the difference
+// to the previous sample of the channel (modulo 256, mapped to 0, -1, 1, -2, ...) with an
+// adaptive Rice code: quotient in unary (ones, ended by a zero), then the low k bits. k follows
+// the mean of recent codes. A quotient of CODEC_ESCAPE or more is sent as CODEC_ESCAPE ones and
+// the mapped difference in 8 bits.
+#define CODEC_ESCAPE                    (4u)
+#define CODEC_K_MAX                     (7u)
+#define CODEC_MAX_SAMPLE_BITS           (CODEC_ESCAPE + 8u)
+
+// Statistics of a channel start with a mean of 2^CODEC_K_START and are halved after
+// CODEC_ADAPT_LIMIT codes
+#define CODEC_K_START                   (2u)
+#define CODEC_ADAPT_LIMIT               (16u)
+
+
+// *************************************************************************************************
+// Global Variable section
+
+// Coder state of a sample channel
+struct codec_channel
+{
+    u8          last;                   // Previous sample
+    u8          count;                  // Codes in sum
+    u16         sum;                    // Sum of mapped differences
+};
+
+// Bit stream, most significant bit first
+struct codec_writer
+{
+    u8 *        buffer;
+    u16         size;                   // Bytes
+    u16         bits;                   // Bits written
+};
+
+
+// *************************************************************************************************
+// Extern section
+
+
+#endif /*CODEC_H_*/
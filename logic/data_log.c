@@ -0,0 +1,257 @@
+// *************************************************************************************************
+// Data logger. Fixed size entries are appended to a circular flash log and read back by entry
+// index for the sync memory download. Entries are written from the idle loop.
+// *************************************************************************************************
+
+// *************************************************************************************************
+// Include section
+
+// system
+#include "project.h"
+#include <string.h>
+
+// driver
+#include "flash.h"
+
+// logic
+#include "data_log.h"
+
+
+// *************************************************************************************************
+// Global Variable section
+struct data_log sDataLog;
+
+
+// *************************************************************************************************
+// @fn          data_log_segment_address
+// @brief       Flash address of a log segment.
+// @param       u8 segment          Segment number
+// @return      u16                 Address of the segment header
+// *************************************************************************************************
+u16 data_log_segment_address(u8 segment)
+{
+    return (DATA_LOG_FLASH_START + (u16)segment * FLASH_SEGMENT_SIZE);
+}
+
+
+// *************************************************************************************************
+// @fn          scan_data_log
+// @brief       Finds the oldest and the newest segment and the first free slot of the newest.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void scan_data_log(void)
+{
+    const struct data_log_segment * header;
+    const u8 * slot;
+    u16 oldest = 0;
+    u8 segment;
+
+    sDataLog.tail       = 0;
+    sDataLog.head       = 0;
+    sDataLog.head_slot  = 1;
+    sDataLog.head_valid = 0;
+    sDataLog.sequence   = 0;
+
+    for (segment = 0; segment < DATA_LOG_SEGMENTS; segment++) {
+        header = (const struct data_log_segment *)data_log_segment_address(segment);
+        if (header->magic != DATA_LOG_MAGIC) continue;
+
+        // Sequence numbers wrap - compare differences
+        if (!sDataLog.head_valid || ((s16)(header->sequence - sDataLog.sequence) > 0)) {
+            sDataLog.head = segment;
+            sDataLog.sequence = header->sequence;
+        }
+        if (!sDataLog.head_valid || ((s16)(header->sequence - oldest) < 0)) {
+            sDataLog.tail = segment;
+            oldest = header->sequence;
+        }
+        sDataLog.head_valid = 1;
+    }
+
+    // Entries start with the type, which is never 0xFF
+    if (sDataLog.head_valid) {
+        slot = (const u8 *)data_log_segment_address(sDataLog.head) + DATA_LOG_ENTRY_SIZE;
+        while ((sDataLog.head_slot <= DATA_LOG_ENTRIES_PER_SEGMENT) && (*slot != 0xFF)) {
+            sDataLog.head_slot++;
+            slot += DATA_LOG_ENTRY_SIZE;
+        }
+    }
+
+    sDataLog.state = DATA_LOG_STATE_READY;
+}
+
+
+// *************************************************************************************************
+// @fn          reset_data_log
+// @brief       Reset data logger. Flash is scanned from the idle loop or on first access.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void reset_data_log(void)
+{
+    sDataLog.state   = DATA_LOG_STATE_SCAN;
+    sDataLog.pending = 0;
+}
+
+
+// *************************************************************************************************
+// @fn          data_log_append
+// @brief       Queue an entry for the log. It is programmed by the idle loop.
+// @param       const u8 * entry    DATA_LOG_ENTRY_SIZE bytes, first byte is the entry type
+// @return      u8                  1 = queued, 0 = queue is full
+// *************************************************************************************************
+u8 data_log_append(const u8 * entry)
+{
+    if (sDataLog.pending >= DATA_LOG_QUEUE_LENGTH) return (0);
+
+    memcpy(sDataLog.queue[sDataLog.pending], entry, DATA_LOG_ENTRY_SIZE);
+    sDataLog.pending++;
+    return (1);
+}
+
+
+// *************************************************************************************************
+// @fn          data_log_count
+// @brief       Returns the number of entries in the log.
+// @param       none
+// @return      u16                 Entries in flash
+// *************************************************************************************************
+u16 data_log_count(void)
+{
+    u8 full_segments;
+
+    if (sDataLog.state == DATA_LOG_STATE_SCAN) scan_data_log();
+    if (!sDataLog.head_valid) return (0);
+
+    full_segments = (sDataLog.head + DATA_LOG_SEGMENTS - sDataLog.tail) % DATA_LOG_SEGMENTS;
+    return ((u16)full_segments * DATA_LOG_ENTRIES_PER_SEGMENT + sDataLog.head_slot - 1);
+}
+
+
+// *************************************************************************************************
+// @fn          data_log_read
+// @brief       Copies an entry from flash. Entry 0 is the oldest entry.
+// @param       u16 index           Entry index
+//              u8 * dest           DATA_LOG_ENTRY_SIZE bytes, set to 0xFF if there is no entry
+// @return      u8                  1 = entry exists
+// *************************************************************************************************
+u8 data_log_read(u16 index, u8 * dest)
+{
+    u8 segment;
+    u16 address;
+
+    if (index >= data_log_count()) {
+        memset(dest, 0xFF, DATA_LOG_ENTRY_SIZE);
+        return (0);
+    }
+
+    // All segments but the head are full
+    segment = (sDataLog.tail + index / DATA_LOG_ENTRIES_PER_SEGMENT) % DATA_LOG_SEGMENTS;
+    address = data_log_segment_address(segment)
+              + (index % DATA_LOG_ENTRIES_PER_SEGMENT + 1) * DATA_LOG_ENTRY_SIZE;
+    memcpy(dest, (const u8 *)address, DATA_LOG_ENTRY_SIZE);
+    return (1);
+}
+
+
+// *************************************************************************************************
+// @fn          erase_data_log
+// @brief       Erase all entries. The log is empty at once, the segments are erased by the idle
+//              loop, one per pass. The log continues with the segment after the last head
+//              instead of starting over with the first segment.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void erase_data_log(void)
+{
+    if (sDataLog.state == DATA_LOG_STATE_SCAN) scan_data_log();
+
+    sDataLog.head          = (sDataLog.head + 1) % DATA_LOG_SEGMENTS;
+    sDataLog.tail          = sDataLog.head;
+    sDataLog.head_slot     = 1;
+    sDataLog.head_valid    = 0;
+    sDataLog.erase_segment = 0;
+    sDataLog.state         = DATA_LOG_STATE_ERASE;
+}
+
+
+// *************************************************************************************************
+// @fn          is_data_log_pending
+// @brief       Returns 1 if the idle loop has flash work to do.
+// @param       none
+// @return      u8                  1 = call write_data_log() instead of sleeping
+// *************************************************************************************************
+u8 is_data_log_pending(void)
+{
+    return ((sDataLog.state != DATA_LOG_STATE_READY) || sDataLog.pending);
+}
+
+
+// *************************************************************************************************
+// @fn          write_data_log
+// @brief       Flash work of the logger, one step per idle loop pass: scan the log after reset,
+//              erase one segment of an erased log, erase the next segment, program its header,
+//              or program the oldest queued entry. Each pass erases at most one segment, so 
+//              higher priority tasks get a turn between the 32 ms erases.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void write_data_log(void)
+{
+    struct data_log_segment header;
+    u16 address;
+    u8 segment;
+
+    if (sDataLog.state == DATA_LOG_STATE_SCAN) {
+        scan_data_log();
+        return;
+    }
+
+    if (sDataLog.state == DATA_LOG_STATE_ERASE) {
+        while (sDataLog.erase_segment < DATA_LOG_SEGMENTS) {
+            address = data_log_segment_address(sDataLog.erase_segment++);
+            if (!flash_is_erased(address, FLASH_SEGMENT_SIZE)) {
+                flash_erase_segment(address);
+                return;
+            }
+        }
+        sDataLog.state = DATA_LOG_STATE_READY;
+        return;
+    }
+    if (!sDataLog.pending) return;
+
+    if (!sDataLog.head_valid || (sDataLog.head_slot > DATA_LOG_ENTRIES_PER_SEGMENT)) {
+        segment = sDataLog.head;
+        if (sDataLog.head_valid) {
+            // Next segment, drop the oldest segment before erasing it if the head runs into it
+            segment = (segment + 1) % DATA_LOG_SEGMENTS;
+            if (segment == sDataLog.tail) {
+                sDataLog.tail = (sDataLog.tail + 1) % DATA_LOG_SEGMENTS;
+            }
+        }
+
+        // Erase in this pass, header in the next. The head moves once the header is programmed.
+        address = data_log_segment_address(segment);
+        if (!flash_is_erased(address, FLASH_SEGMENT_SIZE)) {
+            flash_erase_segment(address);
+            return;
+        }
+        sDataLog.sequence++;
+        header.magic    = DATA_LOG_MAGIC;
+        header.sequence = sDataLog.sequence;
+        flash_write(address, (const u8 *)&header, sizeof(struct data_log_segment));
+
+        sDataLog.head       = segment;
+        sDataLog.head_slot  = 1;
+        sDataLog.head_valid = 1;
+        return;
+    }
+
+    address = data_log_segment_address(sDataLog.head) + (u16)sDataLog.head_slot * DATA_LOG_ENTRY_SIZE;
+    flash_write(address, sDataLog.queue[0], DATA_LOG_ENTRY_SIZE);
+    sDataLog.head_slot++;
+
+    sDataLog.pending--;
+    memmove(sDataLog.queue[0], sDataLog.queue[1], (u16)sDataLog.pending * DATA_LOG_ENTRY_SIZE);
+}
@@ -0,0 +1,90 @@
+// *************************************************************************************************
+
+#ifndef DATA_LOG_H_
+#define DATA_LOG_H_
+
+
+// *************************************************************************************************
+// Include section
+
+
+// *************************************************************************************************
+// Prototypes section
+extern void reset_data_log(void);
+extern u8 data_log_append(const u8 * entry);
+extern u16 data_log_count(void);
+extern u8 data_log_read(u16 index, u8 * dest);
+extern void erase_data_log(void);
+extern u8 is_data_log_pending(void);
+extern void write_data_log(void);
+
+
+// *************************************************************************************************
+// Defines section
+
+// Flash region DATA_LOG reserved in lnk_cc430f6137.cmd. The log is appended segment after
+// segment around the region, so every segment is erased equally often. When the region is full,
+// the oldest segment is erased.
+#define DATA_LOG_FLASH_START            (0x8800u)
+#define DATA_LOG_SEGMENTS               (4u)
+
+// Entries have the size of a sync memory packet payload. The first entry slot of a segment holds
+// the segment header.
+#define DATA_LOG_ENTRY_SIZE             (16u)
+#define DATA_LOG_ENTRIES_PER_SEGMENT    (FLASH_SEGMENT_SIZE / DATA_LOG_ENTRY_SIZE - 1)
+#define DATA_LOG_MAGIC                  (0xDA7Au)
+
+// Entry types (first entry byte, never 0xFF)
+#define DATA_LOG_TYPE_FALL_ALARM        (1u)
+#define DATA_LOG_TYPE_FALL_ALERT        (2u)
+
+// Entries waiting for the idle loop
+#define DATA_LOG_QUEUE_LENGTH           (2u)
+
+// Flash state of the log
+#define DATA_LOG_STATE_SCAN             (0u)    // Find head and tail segment after reset
+#define DATA_LOG_STATE_READY            (1u)
+#define DATA_LOG_STATE_ERASE            (2u)    // Erase all segments, one per idle loop pass
+
+
+// *************************************************************************************************
+// Global Variable section
+
+// Segment header as stored in flash
+struct data_log_segment
+{
+    u16         magic;
+    u16         sequence;               // Increments with every segment opened
+};
+
+struct data_log
+{
+    // DATA_LOG_STATE_SCAN, DATA_LOG_STATE_READY, DATA_LOG_STATE_ERASE
+    u8          state;
+
+    // Next segment to erase in DATA_LOG_STATE_ERASE
+    u8          erase_segment;
+
+    // Oldest segment, segment appended to, and next free entry slot in it
+    u8          tail;
+    u8          head;
+    u8          head_slot;
+
+    // 1 = head segment has its header
+    u8          head_valid;
+
+    // Sequence number of the head segment
+    u16         sequence;
+
+    // Entries waiting for flash, oldest first, and their number
+    u8          queue[DATA_LOG_QUEUE_LENGTH][DATA_LOG_ENTRY_SIZE];
+    u8          pending;
+};
+extern struct data_log sDataLog;
+
+
+// *************************************************************************************************
+// Extern section
+
+
+#endif /*DATA_LOG_H_*/
@@ -13,22 +13,32 @@
 // logic
 #include "alarm.h"
 #include "fall_detection.h"
+#include "fall_height.h"
+#include "fall_recorder.h"
+#include "magnitude.h"
+#include "rfsimpliciti.h"
 #include "simpliciti.h"
 #include "user.h"
-#include <math.h>
 
 // *************************************************************************************************
 // Global Variable section
 struct accel sAccel;
 
-u16 fall_data[FALL_DETECTION_WINDOW_IN_SAMPLES];
-u16 * readIndex = NULL;
+struct fall sFall;
 
-// Conversion values from data to mgrav taken from CMA3000-D0x datasheet (rev 0.4, table 4)
-const u16 mgrav_per_bit[7] = { 18, 36, 71, 143, 286, 571, 1142 };
-// TODO: Implement use (#ifdef) of the 8g values and uncomment the 2 lines below
-//const u16 mgrav_per_bit_2g[7] = { 18, 36, 71, 143, 286, 571, 1142 };
-//const u16 mgrav_per_bit_8g[7] = { 71, 143, 286, 571, 1142, 2286, 4571 };
+// Filtered acceleration in FALL_UNIT_MGRAV units, saturated to 8 bit
+u8 fall_data[FALL_DETECTION_WINDOW_IN_SAMPLES];
+
+// One bit per FIFO buffer position, 1 = sample taken with ACC_CANDIDATE_SAMPLING_RATE
+u8 fall_fast[(FALL_DETECTION_WINDOW_IN_SAMPLES + 7) / 8];
+
+// Raw X/Y/Z acceleration taken every POSTURE_INTERVAL_MS for the posture stage
+s8 posture_data[POSTURE_HISTORY_LENGTH][3];
+
+// Conversion values from data to mgrav taken from CMA3000-D0x datasheet (rev 0.4, table 4):
+// weight of data bit 6, i.e. mgrav per 64 LSB, for 2g and 8g range
+const u16 mgrav_per_64_lsb_2g = 1142;
+const u16 mgrav_per_64_lsb_8g = 4571;
 
 // *************************************************************************************************
 // Extern section
@@ -38,42 +48,262 @@ extern u8 as_ok;
 
 
 
+// *************************************************************************************************
+// @fn          fifo_position
+// @brief       Converts a sample offset into a FIFO buffer position.
+// @param       u16 backsamples - Sample back offset (0 = newest sample).
+// @return      u16             - FIFO buffer position of the sample.
+// *************************************************************************************************
+u16 fifo_position(u16 backsamples)
+{
+    // write_index points one past the newest sample
+    if (backsamples < sFall.write_index) {
+        return (sFall.write_index - 1 - backsamples);
+    } else {
+        return (FALL_DETECTION_WINDOW_IN_SAMPLES + sFall.write_index - 1 - backsamples);
+    }
+}
+
+
+// *************************************************************************************************
+// @fn          read_data_from_fifo_buffer
+// @brief       Reads data from the FIFO buffer with sample offset.
+// @param       u16 backsamples - Sample back offset (0 = newest sample).
+// @return      u8              - Value of the previous sample.
+// *************************************************************************************************
+u8 read_data_from_fifo_buffer(u16 backsamples)
+{
+    return (fall_data[fifo_position(backsamples)]);
+}
+
+
+// *************************************************************************************************
+// @fn          read_period_from_fifo_buffer
+// @brief       Sample period of a FIFO buffer entry.
+// @param       u16 backsamples - Sample back offset (0 = newest sample).
+// @return      u8              - Sample period (1/FALL_TIME_UNITS_PER_MS ms).
+// *************************************************************************************************
+u8 read_period_from_fifo_buffer(u16 backsamples)
+{
+    u16 position = fifo_position(backsamples);
+
+    if (fall_fast[position >> 3] & (1u << (position & 7))) {
+        return (FALL_PERIOD(ACC_CANDIDATE_SAMPLING_RATE));
+    }
+    return (FALL_PERIOD(ACC_SAMPLING_RATE));
+}
+
+
+// *************************************************************************************************
+// @fn          abs_difference
+// @brief       Returns the absolute difference of two samples.
+// @param       u8 a, u8 b      - Samples to compare.
+// @return      u8              - |a - b|
+// *************************************************************************************************
+u8 abs_difference(u8 a, u8 b)
+{
+    return ((a >= b) ? (a - b) : (b - a));
+}
+
+
+// *************************************************************************************************
+// @fn          add_saturated
+// @brief       Adds two 8-bit values, the result sticks at 255 instead of wrapping.
+// @param       u8 a, u8 b      - Values to add.
+// @return      u8              - min(a + b, 255)
+// *************************************************************************************************
+u8 add_saturated(u8 a, u8 b)
+{
+    return ((a > (u8)(255 - b)) ? 255 : (a + b));
+}
+
+
+// *************************************************************************************************
+// @fn          mgrav_to_fall_unit
+// @brief       Rounds an acceleration to FALL_UNIT_MGRAV units and saturates it to 8 bit.
+// @param       u16 mgrav       - Acceleration (mgrav).
+// @return      u8              - Acceleration (FALL_UNIT_MGRAV units).
+// *************************************************************************************************
+u8 mgrav_to_fall_unit(u16 mgrav)
+{
+    mgrav = (mgrav + (FALL_UNIT_MGRAV / 2)) / FALL_UNIT_MGRAV;
+    return ((mgrav > 255) ? 255 : (u8)mgrav);
+}
+
+
 // *************************************************************************************************
 // @fn          write_data_to_fifo_buffer
 // @brief       Adds data to the FIFO buffer and removes old data if buffer is full.
-// @param       u16 * buff_addr     - Pointer to FIFO buffer.
-//              u16 data            - Data to be added to FIFO buffer.
+//              The running free fall sum is updated with the samples entering and leaving
+//              the free fall window. Each sample is weighted with its period, so the window
+//              covers FREE_FALL_BACKTRACK_IN_SECONDS across a rate change.
+// @param       u8 data             - Data to be added to FIFO buffer.
 // @return      none
 // *************************************************************************************************
-void write_data_to_fifo_buffer(u16 * buff_addr, u16 data)
+void write_data_to_fifo_buffer(u8 data)
 {
-    static u8 writeIndex = 0;
+    u16 position = sFall.write_index;
+    u8 period;
 
-    if (writeIndex >= FALL_DETECTION_WINDOW_IN_SAMPLES) {
-        writeIndex = 0;
+    fall_data[position] = data;
+    if (sFall.rate == ACC_CANDIDATE_SAMPLING_RATE) {
+        fall_fast[position >> 3] |= (u8)(1u << (position & 7));
+    } else {
+        fall_fast[position >> 3] &= (u8)~(1u << (position & 7));
+    }
+    if (++sFall.write_index >= FALL_DETECTION_WINDOW_IN_SAMPLES) {
+        sFall.write_index = 0;
+    }
+    if (sFall.fill_count <= FALL_DETECTION_WINDOW_IN_SAMPLES) {
+        sFall.fill_count++;
     }
-    *(u16 *)(buff_addr + writeIndex) = data;
-    writeIndex++;
 
-    readIndex = (u16 *)(buff_addr + writeIndex - 1);
+    // Newest sample enters the free fall window
+    sFall.free_fall_sum += (u32)data * sFall.period;
+    sFall.free_fall_time += sFall.period;
+    sFall.free_fall_samples++;
+
+    // Oldest samples leave while the rest still covers the window. The window must not reach
+    // the sample written next.
+    while (sFall.free_fall_samples > 1) {
+        period = read_period_from_fifo_buffer(sFall.free_fall_samples - 1);
+        if ((sFall.free_fall_time - period < FREE_FALL_WINDOW_TIME)
+            && (sFall.free_fall_samples < FALL_DETECTION_WINDOW_IN_SAMPLES)) {
+            break;
+        }
+        sFall.free_fall_sum -= (u32)read_data_from_fifo_buffer(sFall.free_fall_samples - 1) * period;
+        sFall.free_fall_time -= period;
+        sFall.free_fall_samples--;
+    }
 }
 
 
 // *************************************************************************************************
-// @fn          read_data_from_fifo_buffer
-// @brief       Reads data from the FIFO buffer with sample offset.
-// @param       u16 * buff_addr - Address of FIFO buffer.
-//              u8 backsamples  - Sample back offset.
-// @return      u16 *           - Address of a previous sample.
+// @fn          reset_fifo_buffer
+// @brief       Clears the FIFO buffer and returns the detector to the idle stage.
+// @param       none
+// @return      none
 // *************************************************************************************************
-u16 * read_data_from_fifo_buffer(u16 * buff_addr, u8 backsamples)
+void reset_fifo_buffer(void)
 {
-    u8 offset;
-    offset = (readIndex - buff_addr)/sizeof(u16);
-    if (backsamples > offset) {
-        return ((u16 *)(buff_addr + FALL_DETECTION_WINDOW_IN_SAMPLES + offset - backsamples));
-    } else {
-        return ((u16 *)(buff_addr + offset - backsamples));
+    u16 i;
+
+    for (i = 0; i < FALL_DETECTION_WINDOW_IN_SAMPLES; i++) {
+        fall_data[i] = 0;
+    }
+    for (i = 0; i < sizeof(fall_fast); i++) {
+        fall_fast[i] = 0;
+    }
+    sFall.state         = FALL_STATE_IDLE;
+    sFall.stage_time    = 0;
+    sFall.write_index   = 0;
+    sFall.fill_count    = 0;
+    sFall.free_fall_sum = 0;
+    sFall.free_fall_samples = 0;
+    sFall.free_fall_time = 0;
+    sFall.motion_sum    = 0;
+    stop_fall_height_candidate();
+
+    // Posture history is outdated as well
+    sFall.posture_fill  = 0;
+
+    // So is a fall record still waiting for its samples
+    discard_fall_record();
+}
+
+
+// *************************************************************************************************
+// @fn          write_posture_history
+// @brief       Stores the raw axis values every POSTURE_INTERVAL_MS. Between two entries the
+//              cost is a counter decrement.
+// @param       u8 * acc_data       Raw X/Y/Z acceleration data
+// @return      none
+// *************************************************************************************************
+void write_posture_history(u8 * acc_data)
+{
+    if (--sFall.posture_countdown > 0) return;
+    sFall.posture_countdown = sFall.posture_interval;
+
+    posture_data[sFall.posture_index][0] = (s8)acc_data[0];
+    posture_data[sFall.posture_index][1] = (s8)acc_data[1];
+    posture_data[sFall.posture_index][2] = (s8)acc_data[2];
+    if (++sFall.posture_index >= POSTURE_HISTORY_LENGTH) {
+        sFall.posture_index = 0;
+    }
+    if (sFall.posture_fill < POSTURE_HISTORY_LENGTH) {
+        sFall.posture_fill++;
+    }
+}
+
+
+// *************************************************************************************************
+// @fn          average_posture
+// @brief       Averages POSTURE_AVERAGE_ENTRIES history entries to a gravity vector.
+// @param       u8 backentries      Entry back offset of the newest entry used (0 = newest entry)
+//              s8 * gravity        Averaged X/Y/Z acceleration
+// @return      none
+// *************************************************************************************************
+void average_posture(u8 backentries, s8 * gravity)
+{
+    s16 sum[3] = { 0, 0, 0 };
+    u8 i, axis;
+    u8 index;
+
+    // posture_index points one past the newest entry
+    index = (sFall.posture_index + POSTURE_HISTORY_LENGTH - 1 - backentries) % POSTURE_HISTORY_LENGTH;
+    for (i = 0; i < POSTURE_AVERAGE_ENTRIES; i++) {
+        for (axis = 0; axis < 3; axis++) {
+            sum[axis] += posture_data[index][axis];
+        }
+        index = (index == 0) ? (POSTURE_HISTORY_LENGTH - 1) : (index - 1);
+    }
+    for (axis = 0; axis < 3; axis++) {
+        gravity[axis] = (s8)(sum[axis] / POSTURE_AVERAGE_ENTRIES);
+    }
+}
+
+
+// *************************************************************************************************
+// @fn          set_fall_detection_rate
+// @brief       Switch sensor to another sample rate. The detector follows when the first sample
+//              with the new rate leaves the sample ring (scale_fall_detection()).
+// @param       u16 rate            Requested sample rate (Hz)
+// @return      none
+// *************************************************************************************************
+void set_fall_detection_rate(u16 rate)
+{
+    // Rate trigger must not fire while the rate is changed here
+    as_set_rate_trigger(0, 0);
+    as_set_rate(rate);
+
+    // Candidates are sampled with the higher rate from their first sample on
+    if ((rate == ACC_SAMPLING_RATE) && (sFall.state == FALL_STATE_IDLE)) {
+        as_set_rate_trigger(FREE_FALL_TRIGGER_THRESHOLD, ACC_CANDIDATE_SAMPLING_RATE);
+    }
+}
+
+
+// *************************************************************************************************
+// @fn          scale_fall_detection
+// @brief       Scale the detector to the sample rate of the samples processed next. Windows and
+//              timeouts are kept in time units, filter and slew rate are scaled from
+//              FALL_TUNING_RATE, so the detector behaves the same at every rate.
+// @param       u16 rate            Sample rate (Hz)
+// @return      none
+// *************************************************************************************************
+void scale_fall_detection(u16 rate)
+{
+    sFall.rate       = rate;
+    record_fall_rate(rate);
+    sFall.lpf_weight = (u8)((rate * FALL_TUNING_LPF_WEIGHT) / FALL_TUNING_RATE);
+    sFall.slew_span  = (u8)((rate * FALL_TUNING_SLEW_SPAN) / FALL_TUNING_RATE);
+    sFall.posture_interval = (u8)((rate * POSTURE_INTERVAL_MS) / 1000u);
+    sFall.posture_countdown = sFall.posture_interval;
+    sFall.period     = (u8)FALL_PERIOD(rate);
+
+    // Rate trigger hold time starts with the first sample of the higher rate
+    if (sFall.state == FALL_STATE_IDLE) {
+        sFall.stage_time = 0;
     }
 }
 
@@ -103,16 +333,72 @@ void start_acceleration(void)
     if (!is_acceleration_measurement())
     {
         // Set initial acceleration value corresponding to 1G to prevent false alarms on startup
-        sAccel.data = 16; // TODO: Check if 16 is the correct value corresponding to 1G
+        sAccel.data = 1000;
+
+        // Discard samples and detector statistics of the previous run
+        reset_fifo_buffer();
 
         // Set mode
         sAccel.mode = ACCEL_MODE_ON;
 
+        // Start sensor
+        as_start(ACC_SAMPLING_RATE, AS_RANGE_8G);
+        scale_fall_detection(as_rate);
+        set_fall_detection_rate(ACC_SAMPLING_RATE);
+
+        // Running pressure baseline for the height drop stage
+        start_fall_height();
+
+#ifdef ACCEL_LOW_POWER_MONITORING
+        // Take the posture reference first, then sleep until the sensor detects a free fall
+        sFall.reference_valid = 0;
+        start_posture_reference();
+#endif
+    }
+}
 
 
-        // Start sensor
-        as_start();
+#ifdef ACCEL_LOW_POWER_MONITORING
+// *************************************************************************************************
+// @fn          start_posture_reference
+// @brief       Leave hardware free fall detection for a short measurement burst. The hardware
+//              trigger has no samples before the fall, so the gravity direction is taken from
+//              the burst. Fall detection keeps running on the burst samples.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void start_posture_reference(void)
+{
+    reset_fifo_buffer();
+    sAccel.data = 1000;
+    sFall.reference_burst = 1;
+    sFall.reference_countdown = POSTURE_REFERENCE_INTERVAL_SECONDS;
+
+    as_set_mode(AS_MODE_MEASUREMENT);
+    as_reset_samples();
+}
+#endif
+
+
+// *************************************************************************************************
+// @fn          is_posture_reference_due
+// @brief       Counts down the posture reference interval. Called every second by the timer ISR.
+// @param       none
+// @return      u8                  1 = a new posture reference has to be taken
+// *************************************************************************************************
+u8 is_posture_reference_due(void)
+{
+#ifdef ACCEL_LOW_POWER_MONITORING
+    // Only needed while the sensor waits for a free fall
+    if (!is_acceleration_measurement() || (as_mode != AS_MODE_FREE_FALL)) return (0);
+
+    if (sFall.reference_countdown > 0) {
+        sFall.reference_countdown--;
     }
+    return (sFall.reference_countdown == 0);
+#else
+    return (0);
+#endif
 }
 
 
@@ -127,6 +413,12 @@ void stop_acceleration(void)
     // Stop acceleration sensor
     as_stop();
 
+    // Store the samples collected after an alarm so far
+    stop_fall_record();
+
+    // Put pressure sensor back to standby (or to the altitude measurement)
+    stop_fall_height();
+
     // Clear mode
     sAccel.mode = ACCEL_MODE_OFF;
 }
@@ -174,6 +466,27 @@ u8 is_acceleration_measurement(void)
 }
 
 
+// *************************************************************************************************
+// @fn          convert_magnitude_to_mgrav
+// @brief       Converts an unsigned acceleration (e.g. vector magnitude) to mgrav units with a
+//              single multiplication. The scale follows the active sensor range.
+// @param       u8 value    Unsigned acceleration in sensor LSB
+// @return      u16         Acceleration (mgrav), rounded
+// *************************************************************************************************
+u16 convert_magnitude_to_mgrav(u8 value)
+{
+  u16 scale;
+
+  if (as_range == AS_RANGE_2G) {
+      scale = mgrav_per_64_lsb_2g;
+  } else {
+      scale = mgrav_per_64_lsb_8g;
+  }
+
+  return ((u16)(((u32)value * scale + 32) >> 6));
+}
+
+
 // *************************************************************************************************
 // @fn          convert_acceleration_value_to_mgrav
 // @brief       Converts measured value to mgrav units
@@ -182,23 +495,7 @@ u8 is_acceleration_measurement(void)
 // *************************************************************************************************
 u16 convert_acceleration_value_to_mgrav(u8 value)
 {
-  u16 result;
-  u8 i;
-
-  if (!acceleration_value_is_positive(value))
-  {
-      // Convert 2's complement negative number to positive number
-      value = ~value;
-      value += 1;
-  }
-
-  result = 0;
-  for (i=0; i<7; i++)
-  {
-      result += ((value & (BIT(i)))>>i) * mgrav_per_bit[i];
-  }
-
-  return (result);
+  return (convert_magnitude_to_mgrav(abs_acceleration(value)));
 }
 
 
@@ -211,24 +508,19 @@ u16 convert_acceleration_value_to_mgrav(u8 value)
 u8 detect_free_fall(void)
 {
     u8 event_weight = 0;
-    u8 sample_index = 0;
-    u16 FreeFallSum = 0;
-
-    for (sample_index = FALL_DETECTION_WINDOW_IN_SAMPLES - FREE_FALL_BACKTRACK_IN_SAMPLES; sample_index < FALL_DETECTION_WINDOW_IN_SAMPLES; sample_index++) {
-        FreeFallSum += *(read_data_from_fifo_buffer(fall_data, sample_index)); // Read the oldest samples stored.
-    }
+    u32 FreeFallSum = sFall.free_fall_sum * FALL_UNIT_MGRAV;  // Sum of the window samples * period (mgrav).
+    u32 Limit = (u32)FREE_FALL_THRESHOLD * sFall.free_fall_time;
+    u32 Step = (u32)FREE_FALL_RATING_STEP * sFall.free_fall_time;
 
     // TODO: Tune the numbers for this part of the algorithm if needed.
-    if (FreeFallSum <= (FREE_FALL_THRESHOLD * FREE_FALL_BACKTRACK_IN_SAMPLES)) {
-        event_weight = ((FREE_FALL_THRESHOLD * FREE_FALL_BACKTRACK_IN_SAMPLES) - FreeFallSum)/8;
-        if ((FREE_FALL_THRESHOLD*FREE_FALL_BACKTRACK_IN_SAMPLES - FreeFallSum)%8 >= 4) {
-            event_weight++;
-        }
+    if (FreeFallSum <= Limit) {
+        // Rounded number of rating steps the window average is below the threshold
+        event_weight = (u8)((Limit - FreeFallSum + Step/2) / Step);
         if (event_weight > 0 && event_weight <=13) {
             event_weight = 1;
         } else if (event_weight > 13 && event_weight <=26) {
             event_weight = 2;
-        } else if (event_weight > 26 && event_weight <=40) {
+        } else if (event_weight > 26) {
             event_weight = 3;
         }
     }
@@ -237,6 +529,35 @@ u8 detect_free_fall(void)
 }
 
 
+// *************************************************************************************************
+// @fn          update_impact_peak
+// @brief       Streaming peak tracker of the impact stage. The sample slew_span positions back
+//              is checked against both neighbours, the sample just written gives its slew rate.
+// @param       u8 sample           Newest sample
+// @return      none
+// *************************************************************************************************
+void update_impact_peak(u8 sample)
+{
+    u8 span = sFall.slew_span;
+    u8 candidate = read_data_from_fifo_buffer(span);
+
+    if ((candidate > read_data_from_fifo_buffer(span + 1)) && (candidate > read_data_from_fifo_buffer(span - 1))
+        && (candidate > sFall.impact_peak)) {
+        sFall.impact_peak = candidate;
+
+        // Drop to the sample slew_span samples after the peak
+        if (candidate > sample) {
+            sFall.impact_slew_rate = candidate - sample;
+        } else {
+            sFall.impact_slew_rate = 0;
+        }
+
+        // Peak is slew_span samples old
+        sFall.peak_age = span * sFall.period;
+    }
+}
+
+
 // *************************************************************************************************
 // @fn          detect_impact
 // @brief       Detect impact after free fall
@@ -245,56 +566,13 @@ u8 detect_free_fall(void)
 // *************************************************************************************************
 u8 detect_impact(void)
 {
-    u8 sample_index = 0;
-    u8 peak_index = 0;
-    u8 i = 0;
     u8 event_weight = 0;
-    u16 ImpactSlewRate = 0;
-    u16 * temp_buff[3];
-    struct peaks sPeaks[5];
-    u8 lowest_peak_index;
-    u8 highest_peak_index;
-
-    /* Find the 5 highest acceleration peaks during the impact */
-    for (sample_index = FALL_DETECTION_WINDOW_IN_SAMPLES - FREE_FALL_BACKTRACK_IN_SAMPLES; sample_index >= FALL_DETECTION_WINDOW_IN_SAMPLES - FREE_FALL_BACKTRACK_IN_SAMPLES - MAX_IMPACT_LENGTH_SAMPLES; sample_index--) {
-        temp_buff[0] = read_data_from_fifo_buffer(fall_data, sample_index - 0);
-        temp_buff[1] = read_data_from_fifo_buffer(fall_data, sample_index - 1);
-        temp_buff[2] = read_data_from_fifo_buffer(fall_data, sample_index - 2);
-        if ((*temp_buff[1] > *temp_buff[0]) && (*temp_buff[1] > *temp_buff[2])) {
-            if (peak_index < 5) {
-                sPeaks[peak_index].peaksBuff = temp_buff[1];
-                sPeaks[peak_index].index = sample_index - 1;
-                peak_index++;
-            } else {
-                for (i = 0; i < 4; i++) {
-                    if (*sPeaks[i].peaksBuff <= *sPeaks[i+1].peaksBuff) {
-                        lowest_peak_index = i;
-                    } else {
-                        lowest_peak_index = i+1;
-                    }
-                }
-                sPeaks[lowest_peak_index].peaksBuff = temp_buff[1];
-                sPeaks[lowest_peak_index].index = sample_index - 1;
-            }
-        }
-    }
-
-    /* Find the highest acceleration peak during the impact */
-    for (i = 0; i < 4; i++) {
-        if (*sPeaks[i].peaksBuff >= *sPeaks[i+1].peaksBuff) {
-            highest_peak_index = i;
-        } else {
-            highest_peak_index = i+1;
-        }
-    }
-
-    /* Calculate the impact slew rate */
-    ImpactSlewRate = *sPeaks[highest_peak_index].peaksBuff - *(read_data_from_fifo_buffer(fall_data, sPeaks[highest_peak_index].index - 2));
+    u16 ImpactPeak = (u16)sFall.impact_peak * FALL_UNIT_MGRAV;
 
     // TODO: Tune the numbers for this part of the algorithm if needed.
-    if ((ImpactSlewRate >= IMPACT_SLEWRATE_THRESHOLD) && (*sPeaks[highest_peak_index].peaksBuff >= IMPACT_STRENGTH_THRESHOLD)) {
-        event_weight = (*sPeaks[highest_peak_index].peaksBuff - IMPACT_STRENGTH_THRESHOLD)/32;
-        if ((*sPeaks[highest_peak_index].peaksBuff - IMPACT_STRENGTH_THRESHOLD)%32 >= 16) {
+    if ((((u16)sFall.impact_slew_rate * FALL_UNIT_MGRAV) >= IMPACT_SLEWRATE_THRESHOLD) && (ImpactPeak >= IMPACT_STRENGTH_THRESHOLD)) {
+        event_weight = (ImpactPeak - IMPACT_STRENGTH_THRESHOLD)/IMPACT_RATING_STEP;
+        if ((ImpactPeak - IMPACT_STRENGTH_THRESHOLD)%IMPACT_RATING_STEP >= IMPACT_RATING_STEP/2) {
             event_weight++;
         }
     }
@@ -312,27 +590,12 @@ u8 detect_impact(void)
 u8 detect_motionlessness(void)
 {
     u8 event_weight = 0;
-    u8 sample_index = 0;
-    u16 temp_buff1 = 0;
-    u16 temp_buff2 = 0;
-    u16 MotionSum = 0;
-
-    temp_buff1 = *(read_data_from_fifo_buffer(fall_data, MAX_MOTIONLESSNESS_SAMPLES - 1));
-
-    for (sample_index = MAX_MOTIONLESSNESS_SAMPLES - 2; sample_index >= 0; sample_index--) {
-        temp_buff2 = *(read_data_from_fifo_buffer(fall_data, sample_index));
-        if (temp_buff1 >= temp_buff2) {
-            MotionSum += temp_buff1 - temp_buff2;
-        } else {
-            MotionSum += temp_buff2 - temp_buff2;
-        }
-        temp_buff1 = temp_buff2;
-    }
+    u16 MotionSum = (u16)sFall.motion_sum * FALL_UNIT_MGRAV;
 
     // TODO: Tune the numbers for this part of the algorithm if needed.
     if (MotionSum <= MOTIONLESSNESS_THESHOLD) {
-        event_weight = (MOTIONLESSNESS_THESHOLD - MotionSum)/13;
-        if ((MOTIONLESSNESS_THESHOLD - MotionSum)%13 >= 6) {
+        event_weight = (MOTIONLESSNESS_THESHOLD - MotionSum)/MOTIONLESSNESS_RATING_STEP;
+        if ((MOTIONLESSNESS_THESHOLD - MotionSum)%MOTIONLESSNESS_RATING_STEP >= MOTIONLESSNESS_RATING_STEP/2) {
             event_weight++;
         }
     }
@@ -341,6 +604,188 @@ u8 detect_motionlessness(void)
 }
 
 
+// *************************************************************************************************
+// @fn          square_norm
+// @brief       Squared length of a raw X/Y/Z vector.
+// @param       s8 * v              X/Y/Z values
+// @return      u16                 x*x + y*y + z*z
+// *************************************************************************************************
+u16 square_norm(s8 * v)
+{
+    return ((u16)((s16)v[0] * v[0]) + (u16)((s16)v[1] * v[1]) + (u16)((s16)v[2] * v[2]));
+}
+
+
+// *************************************************************************************************
+// @fn          detect_posture_change
+// @brief       Compare the gravity direction before the free fall with the direction at the end
+//              of the stillness stage. Only called when all other stages fired.
+// @param       none
+// @return      u8 event_weight     Posture change evaluation
+// *************************************************************************************************
+u8 detect_posture_change(void)
+{
+    s8 after[3];
+    s32 Dot;
+    u32 DotSquare, NormProduct;
+
+    // No history before the free fall (e.g. hardware trigger)
+    if (!sFall.posture_valid) {
+        return (POSTURE_UNKNOWN_RATING);
+    }
+
+    average_posture(0, after);
+
+    // cos(angle) = Dot / (|before| * |after|), compared squared to avoid sqrt and division
+    Dot = (s32)sFall.gravity_before[0] * after[0] + (s32)sFall.gravity_before[1] * after[1]
+        + (s32)sFall.gravity_before[2] * after[2];
+    if (Dot <= 0) {
+        // Turned by 90 degrees or more
+        return (2);
+    }
+    DotSquare = (u32)Dot * (u32)Dot;
+    NormProduct = (u32)square_norm(sFall.gravity_before) * square_norm(after);
+
+    if (DotSquare < NormProduct / 4) {
+        // cos^2 < 1/4: more than 60 degrees
+        return (2);
+    } else if (DotSquare < (NormProduct / 4) * 3) {
+        // cos^2 < 3/4: more than 30 degrees
+        return (1);
+    }
+    return (0);
+}
+
+
+// *************************************************************************************************
+// @fn          enter_fall_stage
+// @brief       Switch the fall detector to another stage and restart the stage timeout.
+// @param       u8 state            FALL_STATE_IDLE, FALL_STATE_FREE_FALL, FALL_STATE_IMPACT,
+//                                  FALL_STATE_STILLNESS
+// @return      none
+// *************************************************************************************************
+void enter_fall_stage(u8 state)
+{
+    sFall.state = state;
+    sFall.stage_time = 0;
+
+    // Sample free fall and impact of a candidate with the higher rate, fall back afterwards
+    if ((state == FALL_STATE_FREE_FALL) || (state == FALL_STATE_IMPACT)) {
+        set_fall_detection_rate(ACC_CANDIDATE_SAMPLING_RATE);
+    } else {
+        set_fall_detection_rate(ACC_SAMPLING_RATE);
+    }
+
+    if (state == FALL_STATE_IDLE) {
+        sFall.hw_trigger = 0;
+        stop_fall_height_candidate();
+    } else if (state == FALL_STATE_FREE_FALL) {
+        // Pressure before the fall is the running baseline, sample the candidate faster
+        start_fall_height_candidate();
+
+        // Gravity direction before the fall, skipping the entries of the fall onset. Without
+        // enough history (hardware trigger) gravity_before still holds the posture reference.
+        if (sFall.posture_fill >= POSTURE_BEFORE_OFFSET + POSTURE_AVERAGE_ENTRIES) {
+            average_posture(POSTURE_BEFORE_OFFSET, sFall.gravity_before);
+            sFall.posture_valid = 1;
+        } else {
+            sFall.posture_valid = sFall.reference_valid;
+        }
+    } else if (state == FALL_STATE_IMPACT) {
+        sFall.impact_peak = 0;
+        sFall.impact_slew_rate = 0;
+        sFall.peak_age = 0;
+    } else if (state == FALL_STATE_STILLNESS) {
+        sFall.motion_sum = 0;
+    }
+}
+
+
+// *************************************************************************************************
+// @fn          update_fall_detection_stage
+// @brief       Fall detector state machine IDLE -> FREE_FALL -> IMPACT -> STILLNESS. The posture
+//              change and the height drop are rated at the end of the stillness stage.
+//              Only the stage that is active does work on a new sample, so while nothing
+//              happens the cost is a single compare. Each stage has its own timeout.
+// @param       u8 sample           Newest filtered acceleration sample (FALL_UNIT_MGRAV units)
+// @return      u8                  1 = fall detected
+// *************************************************************************************************
+u8 update_fall_detection_stage(u8 sample)
+{
+    sFall.stage_time += sFall.period;
+
+    switch (sFall.state)
+    {
+        case FALL_STATE_IDLE:
+            // Cheap free fall trigger
+            if (sample < FALL_UNITS(FREE_FALL_TRIGGER_THRESHOLD)) {
+                enter_fall_stage(FALL_STATE_FREE_FALL);
+            } else if ((sFall.rate != ACC_SAMPLING_RATE) && (sFall.stage_time >= FALL_TIME_MS(FALL_RATE_TRIGGER_HOLD_MS))) {
+                // Sensor raised the rate, but the filtered samples did not follow - drop back
+                enter_fall_stage(FALL_STATE_IDLE);
+            }
+            break;
+
+        case FALL_STATE_FREE_FALL:
+            if (sample >= FALL_UNITS(FREE_FALL_TRIGGER_THRESHOLD)) {
+                // Acceleration returns - rate the free fall and arm the impact search
+                if (sFall.hw_trigger) {
+                    sFall.free_fall_rating = FREE_FALL_HW_RATING;
+                } else {
+                    sFall.free_fall_rating = detect_free_fall();
+                }
+                if (sFall.free_fall_rating > 0) {
+                    enter_fall_stage(FALL_STATE_IMPACT);
+                } else {
+                    enter_fall_stage(FALL_STATE_IDLE);
+                }
+            } else if (sFall.stage_time >= FALL_TIME_MS(FREE_FALL_TIMEOUT_SECONDS * 1000u)) {
+                enter_fall_stage(FALL_STATE_IDLE);
+            }
+            break;
+
+        case FALL_STATE_IMPACT:
+            sFall.peak_age += sFall.period;
+            update_impact_peak(sample);
+            if (sFall.stage_time >= FALL_TIME_MS(IMPACT_TIMEOUT_SECONDS * 1000u)) {
+                sFall.impact_rating = detect_impact();
+                if (sFall.impact_rating > 0) {
+                    enter_fall_stage(FALL_STATE_STILLNESS);
+                } else {
+                    enter_fall_stage(FALL_STATE_IDLE);
+                }
+            }
+            break;
+
+        case FALL_STATE_STILLNESS:
+            sFall.peak_age += sFall.period;
+            sFall.motion_sum = add_saturated(sFall.motion_sum, abs_difference(sample, read_data_from_fifo_buffer(1)));
+            if (sFall.motion_sum > FALL_UNITS(MOTIONLESSNESS_THESHOLD)) {
+                // Wearer is moving - no need to wait for the stage timeout
+                enter_fall_stage(FALL_STATE_IDLE);
+            } else if (sFall.stage_time >= FALL_TIME_MS(STILLNESS_TIMEOUT_SECONDS * 1000u)) {
+                sFall.motionlessness_rating = detect_motionlessness();
+                sFall.posture_rating = detect_posture_change();
+                sFall.height_rating = rate_fall_height();
+                enter_fall_stage(FALL_STATE_IDLE);
+                if ((sFall.free_fall_rating + sFall.impact_rating + sFall.motionlessness_rating
+                     + sFall.posture_rating + sFall.height_rating) >= RATING_THRESHOLD) {
+                    // Latency from impact to alarm (ms)
+                    sFall.alarm_latency = sFall.peak_age / FALL_TIME_UNITS_PER_MS;
+                    return (1);
+                }
+            }
+            break;
+
+        default:
+            enter_fall_stage(FALL_STATE_IDLE);
+            break;
+    }
+
+    return (0);
+}
+
+
 // *************************************************************************************************
 // @fn          sx_fall_detection
 // @brief       Fall detection direct user function. Button DOWN starts/stops the fall detection.
@@ -370,62 +815,121 @@ void sx_fall_detection(u8 line)
 
 
 // *************************************************************************************************
-// @fn          do_fall_detection
-// @brief       Process acceleration data and detect falls.
-// @param       none
+// @fn          process_acceleration_sample
+// @brief       Filter one acceleration sample and run fall detection on it.
+// @param       u8 * acc_data       Raw X/Y/Z acceleration data
 // @return      none
 // *************************************************************************************************
-void do_fall_detection(void) // main()
+void process_acceleration_sample(u8 * acc_data)
 {
-    u8 acc_data[3];
     u16 acc_sum = 0;
-    static u8 isDelayOver = 0;
-    static u8 sample_index = 0;
-    u8 impact_rating = 0;
-    u8 free_fall_rating = 0;
-    u8 motionlessness_rating = 0;
+    u8 sample;
 
-    as_get_data(acc_data);
+    // Integer magnitude (truncated sqrt() of the absolute axis values) in mgrav
+    acc_sum = convert_magnitude_to_mgrav(acc_magnitude(acc_data[0], acc_data[1], acc_data[2]));
 
-    acc_data[0] = abs_acceleration(acc_data[0]);
-    acc_data[1] = abs_acceleration(acc_data[1]);
-    acc_data[2] = abs_acceleration(acc_data[2]);
+    write_posture_history(acc_data);
 
-    acc_sum = sqrt(acc_data[0]*acc_data[0] + acc_data[1]*acc_data[1] + acc_data[2]*acc_data[2]);
-
-    // Filter acceleration data (Low pass filter)
-    acc_sum = (u16)((acc_sum + sAccel.data * 4)/5);
+    // Filter acceleration data (Low pass filter, same time constant at every rate)
+    acc_sum = (u16)((acc_sum + (u32)sAccel.data * sFall.lpf_weight)/(sFall.lpf_weight + 1));
 
     // Store average acceleration
     sAccel.data = acc_sum;
 
-    write_data_to_fifo_buffer(fall_data, acc_sum);
+    // 8-bit sample for FIFO buffer and detector stages
+    sample = mgrav_to_fall_unit(acc_sum);
+    write_data_to_fifo_buffer(sample);
+    record_fall_sample();
 
-    if (isDelayOver) {
+    // Wait until the free fall window is filled with data, unless the hardware started a stage.
+    // A posture reference burst is too short to fill the window. The free fall rating averages
+    // over the time covered, so the burst is watched from its first sample on.
+    if ((sFall.free_fall_time >= FREE_FALL_WINDOW_TIME) || (sFall.state != FALL_STATE_IDLE)
+        || sFall.reference_burst) {
         if (sAlarm.state != ALARM_ON) {
-            // Start fall detection algorithm
-            free_fall_rating = detect_free_fall();
-            if (free_fall_rating > 0) {
-                impact_rating = detect_impact();
-            }
-            if (impact_rating > 0) {
-                motionlessness_rating = detect_motionlessness();
-            }
-            if ((free_fall_rating + impact_rating + motionlessness_rating) >= RATING_THRESHOLD) {
+            // Run fall detection algorithm
+            if (update_fall_detection_stage(sample)) {
 
                 // Stop fall detection and start alarm. (Alarm timeout is 10 seconds.)
                 sAlarm.state = ALARM_ON;
+                // Alert over the air, keep the samples around the alarm for tuning
+                request_fall_alert();
+                start_fall_record();
                 // Use this flag to display that fall has happened in display function.
                 // TODO: Later add blinking backlight support.
                 // Alarm is disabled on any button press and fall detection is resumed. (in ports.c)
                 // TODO: Later add functionality to stop alarm only on long button press.
             }
         }
-    } else {
-        if (++sample_index > FALL_DETECTION_WINDOW_IN_SAMPLES) {    // Wait until data array is filled with data.
-            isDelayOver = 1;
+    }
+}
+
+
+// *************************************************************************************************
+// @fn          do_fall_detection
+// @brief       Process acceleration data and detect falls. Called once per batch of samples
+//              collected by the sensor driver.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void do_fall_detection(void) // main()
+{
+    u8 acc_data[3];
+    u16 rate;
+
+#ifdef ACCEL_LOW_POWER_MONITORING
+    // Sensor is in free fall detection mode - INT means free fall, not new data
+    if (as_mode == AS_MODE_FREE_FALL) {
+        // Reading the status clears the sensor interrupt
+        if (as_get_interrupt_status() & AS_INT_STATUS_FFDET) {
+            // The free fall stage starts at the hardware trigger, so no history before the
+            // trigger is needed. Entering the stage selects the candidate sample rate.
+            reset_fifo_buffer();
+            sAccel.data = 0;
+            sFall.reference_burst = 0;
+            enter_fall_stage(FALL_STATE_FREE_FALL);
+            sFall.hw_trigger = 1;
+
+            // Sample for the detection window
+            as_set_mode(AS_MODE_MEASUREMENT);
+            as_reset_samples();
+        } else if (sFall.reference_countdown == 0) {
+            // Posture reference is outdated
+            start_posture_reference();
+        }
+        return;
+    }
+#endif
+
+    // Run detector over all samples collected since last call. Samples arriving from now on
+    // get a new event. Samples taken before a rate change are filtered with their own rate.
+    as_ring_event = 0;
+    while ((rate = as_get_sample(acc_data)) != 0) {
+        if (rate != sFall.rate) {
+            scale_fall_detection(rate);
+        }
+        process_acceleration_sample(acc_data);
+    }
+
+#ifdef ACCEL_LOW_POWER_MONITORING
+    // Detection window is over - drop back to hardware free fall detection. A fall record
+    // needs the samples after the alarm and a FIFO buffer that is not cleared by a new trigger.
+    // The newest posture history is the reference for the next hardware trigger, a burst
+    // continues until it has enough entries. The height before a fall is sampled with it.
+    if ((sFall.state == FALL_STATE_IDLE) && !is_fall_record_busy()) {
+        if (sFall.posture_fill >= POSTURE_AVERAGE_ENTRIES) {
+            average_posture(0, sFall.gravity_before);
+            sFall.reference_valid = 1;
+            sFall.reference_burst = 0;
+            sFall.reference_countdown = POSTURE_REFERENCE_INTERVAL_SECONDS;
+            trigger_fall_height_baseline();
+        }
+        if (!sFall.reference_burst) {
+            as_set_mode(AS_MODE_FREE_FALL);
+            as_reset_samples();
         }
     }
+#endif
     // Update display function
     display.flag.update_fall_detection = 1;
 }
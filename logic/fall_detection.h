@@ -10,7 +10,7 @@
 
 // *************************************************************************************************
 // Prototypes section
-
+extern u8 read_data_from_fifo_buffer(u16 backsamples);
 
 
 // *************************************************************************************************
@@ -22,39 +22,167 @@
 // Stop acceleration measurement after 60 minutes to save battery
 #define ACCEL_MEASUREMENT_TIMEOUT       (60*60u)
 
+// Comment this define to sample continuously with ACC_SAMPLING_RATE instead of waiting for the
+// hardware free fall interrupt of the acceleration sensor
+#define ACCEL_LOW_POWER_MONITORING
+
 // Fall detection defines
+// Sample rate while no fall candidate is tracked, and while the free fall and impact of a
+// candidate are sampled. The FIFO buffer must hold FREE_FALL_BACKTRACK_IN_SECONDS at the
+// candidate rate. The sensor driver raises the rate on the first raw sample with a magnitude below
+// FREE_FALL_TRIGGER_THRESHOLD. Without a free fall trigger the rate drops back after
+// FALL_RATE_TRIGGER_HOLD_MS.
 #define ACC_SAMPLING_RATE 40
-#define FALL_DETECTION_WINDOW_IN_SECONDS 4
+#define ACC_CANDIDATE_SAMPLING_RATE 100
+#define FALL_DETECTION_WINDOW_IN_SECONDS 8
 #define FALL_DETECTION_WINDOW_IN_SAMPLES (FALL_DETECTION_WINDOW_IN_SECONDS * ACC_SAMPLING_RATE)
 #define FREE_FALL_BACKTRACK_IN_SECONDS 1
-#define FREE_FALL_BACKTRACK_IN_SAMPLES (FREE_FALL_BACKTRACK_IN_SECONDS * ACC_SAMPLING_RATE)
-#define MAX_IMPACT_LENGTH_SAMPLES ACC_SAMPLING_RATE
-#define MAX_MOTIONLESSNESS_SAMPLES 2*ACC_SAMPLING_RATE
-// TODO: Use 7-bit values or 8192 max ???
-#define IMPACT_SLEWRATE_THRESHOLD 16    /*1024*/    // Difference between 2 samples (equals around 1G)
-#define IMPACT_STRENGTH_THRESHOLD 32    /*2048*/
-#define FREE_FALL_THRESHOLD 8           /*640*/     // This is the average of 40 samples of free falling
-#define MOTIONLESSNESS_THESHOLD 40      /*2840*/    // This is the sum of the deltas between 80 samples of motionless
-#define RATING_THRESHOLD 5                          // TODO: This is just an example - modify it appropriately.
+#define FALL_RATE_TRIGGER_HOLD_MS 250
+#define MAX_IMPACT_LENGTH_SECONDS 1
+#define MAX_MOTIONLESSNESS_SECONDS 2
+// Thresholds in mgrav, independent of sensor range and sample rate
+#define IMPACT_SLEWRATE_THRESHOLD 1140              // Drop from the impact peak (equals around 1G)
+#define IMPACT_STRENGTH_THRESHOLD 2290
+#define FREE_FALL_THRESHOLD 570                     // This is the average of the free fall window
+#define MOTIONLESSNESS_THESHOLD 2860                // This is the sum of the deltas during the stillness stage
+#define RATING_THRESHOLD 7                          // TODO: This is just an example - modify it appropriately.
+                                                    // Includes the height drop rating (fall_height.h)
+
+// Rating steps in mgrav: one rating point per step beyond the threshold
+#define FREE_FALL_RATING_STEP 14                    // Window average below FREE_FALL_THRESHOLD
+#define IMPACT_RATING_STEP 2290                     // Impact peak above IMPACT_STRENGTH_THRESHOLD
+#define MOTIONLESSNESS_RATING_STEP 930              // Delta sum below MOTIONLESSNESS_THESHOLD
+
+// FIFO buffer and detector stages work on 8-bit samples in units of FALL_UNIT_MGRAV
+// (saturating at 255 units = 16.3g, above the 8g range magnitude of 15.8g)
+#define FALL_UNIT_MGRAV 64
+#define FALL_UNITS(mgrav) (((mgrav) + (FALL_UNIT_MGRAV / 2)) / FALL_UNIT_MGRAV)
+
+// Time base of the tuning above. Filter time constant, slew rate distance and free fall rating
+// are scaled from this rate to the active rate.
+#define FALL_TUNING_RATE 40
+#define FALL_TUNING_LPF_WEIGHT 4                    // Filter: (new + 4 * old) / 5
+#define FALL_TUNING_SLEW_SPAN 2                     // Slew rate over 2 samples
+
+// A single filtered sample below this value (mgrav) arms the free fall stage
+#define FREE_FALL_TRIGGER_THRESHOLD 570
+
+// Free fall rating given to a free fall confirmed by the sensor hardware (no sample history exists)
+#define FREE_FALL_HW_RATING 2
+
+// Posture stage: raw axis values are stored every POSTURE_INTERVAL_MS. The gravity direction is
+// averaged over POSTURE_AVERAGE_ENTRIES entries, before the fall skipping POSTURE_BEFORE_OFFSET
+// entries of the fall onset. Orientation change gives 1 point above 30 and 2 points above 60 degrees.
+#define POSTURE_HISTORY_LENGTH          16
+#define POSTURE_INTERVAL_MS             100
+#define POSTURE_AVERAGE_ENTRIES         8
+#define POSTURE_BEFORE_OFFSET           4
+
+// Posture rating if the direction before the fall is unknown (no posture reference yet)
+#define POSTURE_UNKNOWN_RATING          1
+
+// Hardware free fall detection has no samples before the fall. The gravity direction before the
+// fall is taken from a short measurement burst every POSTURE_REFERENCE_INTERVAL_SECONDS, and
+// from the end of every detection window.
+#define POSTURE_REFERENCE_INTERVAL_SECONDS  30
+
+// Stage timeouts (seconds). A free fall longer than the timeout is not a fall of a person.
+#define FREE_FALL_TIMEOUT_SECONDS       2
+#define IMPACT_TIMEOUT_SECONDS          MAX_IMPACT_LENGTH_SECONDS
+#define STILLNESS_TIMEOUT_SECONDS       MAX_MOTIONLESSNESS_SECONDS
+
+// Worst case latency from the impact peak to the alarm (ms)
+#define FALL_ALARM_MAX_LATENCY_MS       ((IMPACT_TIMEOUT_SECONDS + STILLNESS_TIMEOUT_SECONDS) * 1000u)
+
+// Sample period unit used for time keeping (exact for 40, 100 and 400Hz)
+#define FALL_TIME_UNITS_PER_MS          4
+#define FALL_TIME_MS(ms)                ((ms) * FALL_TIME_UNITS_PER_MS)
+#define FALL_PERIOD(rate)               ((1000u * FALL_TIME_UNITS_PER_MS) / (rate))
+
+// Free fall window. Samples of both rates can be in the window, so it is kept in time units.
+#define FREE_FALL_WINDOW_TIME           FALL_TIME_MS(FREE_FALL_BACKTRACK_IN_SECONDS * 1000u)
+
+// Fall detector stages
+#define FALL_STATE_IDLE         (0u)    // Only the free fall trigger runs
+#define FALL_STATE_FREE_FALL    (1u)    // Free fall candidate, waiting for the acceleration to return
+#define FALL_STATE_IMPACT       (2u)    // Searching the highest impact peak
+#define FALL_STATE_STILLNESS    (3u)    // Checking for motionlessness after the impact
 
 
 // *************************************************************************************************
 // Global Variable section
-struct peaks
+struct fall
 {
-    // Storage for the peaks addresses
-    u16 * peaksBuff;
-
-    // Sample index
-    u8 index;
+    // FALL_STATE_IDLE, FALL_STATE_FREE_FALL, FALL_STATE_IMPACT, FALL_STATE_STILLNESS
+    u8          state;
+
+    // Sample rate (Hz) of the samples processed and derived sample counts
+    u16         rate;
+    u8          slew_span;              // Samples between impact peak and slew rate sample
+    u8          lpf_weight;             // Weight of the old value in the low pass filter
+    u8          period;                 // Sample period in 1/FALL_TIME_UNITS_PER_MS ms
+
+    // Time spent in the current stage (1/FALL_TIME_UNITS_PER_MS ms)
+    u16         stage_time;
+
+    // 1 = Free fall stage was entered on the hardware free fall interrupt
+    u8          hw_trigger;
+
+    // FIFO buffer position where the next sample is written
+    u16         write_index;
+
+    // Number of samples written since start (saturates at buffer length + 1)
+    u16         fill_count;
+
+    // Free fall window: running sum of sample * period, number of samples and time covered
+    u32         free_fall_sum;
+    u16         free_fall_samples;
+    u16         free_fall_time;
+
+    // Sum of the sample to sample deltas since the stillness stage started (saturating)
+    u8          motion_sum;
+
+    // Highest impact peak and its slew rate
+    u8          impact_peak;
+    u8          impact_slew_rate;
+
+    // Time since the highest impact peak (1/FALL_TIME_UNITS_PER_MS ms)
+    u16         peak_age;
+
+    // Posture history position, number of entries and samples until the next entry
+    u8          posture_index;
+    u8          posture_fill;
+    u8          posture_interval;
+    u8          posture_countdown;
+
+    // Gravity direction before the free fall (raw X/Y/Z), 1 = valid
+    s8          gravity_before[3];
+    u8          posture_valid;
+
+    // Hardware trigger: gravity_before holds the posture reference, 1 = valid. 1 = burst for
+    // the reference is sampled. Seconds until the next reference.
+    u8          reference_valid;
+    u8          reference_burst;
+    u8          reference_countdown;
+
+    // Ratings of the current fall candidate
+    u8          free_fall_rating;
+    u8          impact_rating;
+    u8          motionlessness_rating;
+    u8          posture_rating;
+    u8          height_rating;
+
+    // Time from the impact peak to the last alarm (ms)
+    u16         alarm_latency;
 };
+extern struct fall sFall;
 
 struct accel
 {
 	// ACC_MODE_OFF, ACC_MODE_ON
 	u8          mode;
 
-    // Temporary buffer for acceleration data
+    // Filtered acceleration (mgrav)
     u16         data;
 };
 extern struct accel sAccel;
@@ -67,5 +195,6 @@ extern void sx_fall_detection(u8 line);
 extern void display_fall_detection(u8 line, u8 update);
 extern u8 is_acceleration_measurement(void);
 extern void do_fall_detection(void);
+extern u8 is_posture_reference_due(void);
 
 #endif /*FALL_DETECTION_H_*/
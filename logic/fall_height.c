@@ -0,0 +1,268 @@
+// *************************************************************************************************
+// Barometric height drop stage of the fall detector. Between candidates the pressure sensor
+// stays in standby. Each posture reference of the accelerometer triggers one single conversion,
+// which is the baseline, the height before a fall. A fall candidate switches the sensor to high
+// speed mode, the samples of the stillness stage give the height after the fall. The baseline
+// predates the fall onset, while the first high speed sample comes 210 ms or more after the fall
+// began, when the wrist has already dropped. Without a baseline that first sample is used.
+// *************************************************************************************************
+
+// *************************************************************************************************
+// Include section
+
+// system
+#include "project.h"
+
+// driver
+#include "vti_ps.h"
+
+// logic
+#include "altitude.h"
+#include "fall_detection.h"
+#include "fall_height.h"
+
+
+// *************************************************************************************************
+// Global Variable section
+struct fall_height sFallHeight;
+
+
+// *************************************************************************************************
+// Extern section
+
+// Global flag for proper pressure sensor operation
+extern u8 ps_ok;
+
+
+// *************************************************************************************************
+// @fn          set_fall_height_mode
+// @brief       Select the sensor mode. The altitude measurement shares the sensor and the DRDY
+//              IRQ, it samples in ultra low power mode.
+// @param       u8 mode             PS_MODE_HIGH_SPEED, PS_MODE_TRIGGERED
+// @return      none
+// *************************************************************************************************
+void set_fall_height_mode(u8 mode)
+{
+    // DRDY IRQ is already enabled while the altitude is measured
+    if (!is_altitude_measurement()) {
+        PS_INT_IFG &= ~PS_INT_PIN;
+        PS_INT_IE  |= PS_INT_PIN;
+    }
+    ps_start(mode);
+}
+
+
+// *************************************************************************************************
+// @fn          start_fall_height
+// @brief       Start the height drop stage. Called when fall detection starts. The sensor stays
+//              in standby until the first posture reference triggers a baseline sample.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void start_fall_height(void)
+{
+    sFallHeight.baseline_valid = 0;
+    sFallHeight.triggered = 0;
+    sFallHeight.drop = 0;
+
+    if (!ps_ok) {
+        sFallHeight.state = FALL_HEIGHT_OFF;
+        return;
+    }
+    sFallHeight.state = FALL_HEIGHT_MONITOR;
+}
+
+
+// *************************************************************************************************
+// @fn          trigger_fall_height_baseline
+// @brief       Take a new baseline sample with a single conversion, the sensor returns to standby
+//              by itself. Called with each posture reference. While the altitude is measured, its
+//              samples update the baseline instead.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void trigger_fall_height_baseline(void)
+{
+    if ((sFallHeight.state != FALL_HEIGHT_MONITOR) || is_altitude_measurement()) return;
+
+    sFallHeight.triggered = 1;
+    set_fall_height_mode(PS_MODE_TRIGGERED);
+}
+
+
+// *************************************************************************************************
+// @fn          stop_fall_height
+// @brief       Stop pressure sampling of the fall detector. The sensor returns to the altitude
+//              measurement if that is active, else to standby.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void stop_fall_height(void)
+{
+    if (sFallHeight.state == FALL_HEIGHT_OFF) return;
+    sFallHeight.state = FALL_HEIGHT_OFF;
+    sFallHeight.triggered = 0;
+
+    if (is_altitude_measurement()) {
+        ps_start(PS_MODE_ULTRA_LOW_POWER);
+    } else {
+        ps_stop();
+        PS_INT_IE  &= ~PS_INT_PIN;
+        PS_INT_IFG &= ~PS_INT_PIN;
+    }
+}
+
+
+// *************************************************************************************************
+// @fn          start_fall_height_candidate
+// @brief       Keep the baseline as the height before the fall and sample the candidate in high
+//              speed mode. Without a baseline the first sample is taken.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void start_fall_height_candidate(void)
+{
+    if (sFallHeight.state != FALL_HEIGHT_MONITOR) return;
+
+    sFallHeight.sum   = 0;
+    sFallHeight.count = 0;
+    sFallHeight.drop  = 0;
+    sFallHeight.triggered = 0;
+    sFallHeight.state = sFallHeight.baseline_valid ? FALL_HEIGHT_TRACK : FALL_HEIGHT_BASELINE;
+    set_fall_height_mode(PS_MODE_HIGH_SPEED);
+}
+
+
+// *************************************************************************************************
+// @fn          stop_fall_height_candidate
+// @brief       Put the sensor back to standby after a candidate, or to the altitude measurement
+//              if that is active. The baseline is dropped, the wearer may be at another height
+//              now. The next posture reference takes a new one.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void stop_fall_height_candidate(void)
+{
+    if ((sFallHeight.state == FALL_HEIGHT_OFF) || (sFallHeight.state == FALL_HEIGHT_MONITOR)) return;
+
+    sFallHeight.baseline_valid = 0;
+    sFallHeight.state = FALL_HEIGHT_MONITOR;
+
+    if (is_altitude_measurement()) {
+        ps_start(PS_MODE_ULTRA_LOW_POWER);
+    } else {
+        ps_stop();
+    }
+}
+
+
+// *************************************************************************************************
+// @fn          is_fall_height_measurement
+// @brief       Returns 1 if pressure samples belong to the fall detector.
+// @param       none
+// @return      u8                  1 = pressure sampling for the fall detector
+// *************************************************************************************************
+u8 is_fall_height_measurement(void)
+{
+    return (sFallHeight.state != FALL_HEIGHT_OFF);
+}
+
+
+// *************************************************************************************************
+// @fn          is_fall_height_candidate
+// @brief       Returns 1 if the sensor samples a fall candidate in high speed mode.
+// @param       none
+// @return      u8                  1 = candidate sampling
+// *************************************************************************************************
+u8 is_fall_height_candidate(void)
+{
+    return ((sFallHeight.state == FALL_HEIGHT_BASELINE) || (sFallHeight.state == FALL_HEIGHT_TRACK));
+}
+
+
+// *************************************************************************************************
+// @fn          is_fall_height_sampling
+// @brief       Returns 1 if the sensor converts for the fall detector, so a DRDY edge is expected.
+// @param       none
+// @return      u8                  1 = candidate sampling or single conversion outstanding
+// *************************************************************************************************
+u8 is_fall_height_sampling(void)
+{
+    return (is_fall_height_candidate() || sFallHeight.triggered);
+}
+
+
+// *************************************************************************************************
+// @fn          do_fall_height_measurement
+// @brief       Read a pressure sample for the fall detector. Between candidates a single conversion
+//              is the new baseline. Samples of the altitude measurement are filtered into the
+//              baseline and passed on. The first sample of a candidate without baseline is the
+//              baseline, samples are averaged while the detector is in the stillness stage.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void do_fall_height_measurement(void)
+{
+    u32 pressure;
+    u16 temperature;
+
+    // If sensor is not ready, skip data read
+    if ((PS_INT_IN & PS_INT_PIN) == 0) return;
+    if (!ps_get_pa_temp(&pressure, &temperature)) return;
+
+    if (sFallHeight.state == FALL_HEIGHT_MONITOR) {
+        if (sFallHeight.baseline_valid && is_altitude_measurement()) {
+            sFallHeight.baseline = (pressure + FALL_HEIGHT_BASELINE_WEIGHT * sFallHeight.baseline)
+                                   / (FALL_HEIGHT_BASELINE_WEIGHT + 1);
+        } else {
+            sFallHeight.baseline = pressure;
+            sFallHeight.baseline_valid = 1;
+        }
+        sFallHeight.temperature = temperature;
+        sFallHeight.triggered = 0;
+        if (is_altitude_measurement()) update_altitude(pressure, temperature, FILTER_ON);
+    } else if (sFallHeight.state == FALL_HEIGHT_BASELINE) {
+        sFallHeight.baseline    = pressure;
+        sFallHeight.temperature = temperature;
+        sFallHeight.state       = FALL_HEIGHT_TRACK;
+    } else if ((sFall.state == FALL_STATE_STILLNESS) && (sFallHeight.count < 255)) {
+        sFallHeight.sum += pressure;
+        sFallHeight.count++;
+    }
+}
+
+
+// *************************************************************************************************
+// @fn          rate_fall_height
+// @brief       Rate the height drop from the baseline to the average of the stillness stage.
+//              Called at the end of the stillness stage.
+// @param       none
+// @return      u8 event_weight     Height drop evaluation
+// *************************************************************************************************
+u8 rate_fall_height(void)
+{
+    u8 event_weight = 0;
+    s32 delta;
+
+    if ((sFallHeight.state != FALL_HEIGHT_TRACK) || (sFallHeight.count == 0)) {
+        return (FALL_HEIGHT_UNKNOWN_RATING);
+    }
+
+    // Pressure rises when the wrist goes down. Limit to 1000Pa (around 80m) to stay in 32 bit.
+    delta = (s32)((sFallHeight.sum + sFallHeight.count / 2) / sFallHeight.count) - (s32)sFallHeight.baseline;
+    if (delta > 1000) {
+        delta = 1000;
+    } else if (delta < -1000) {
+        delta = -1000;
+    }
+    sFallHeight.drop = (s16)((delta * ((s32)sFallHeight.temperature * FALL_HEIGHT_CM_FACTOR)) / (s32)sFallHeight.baseline);
+
+    if (sFallHeight.drop >= FALL_HEIGHT_DROP_THRESHOLD) {
+        event_weight = 1 + (sFallHeight.drop - FALL_HEIGHT_DROP_THRESHOLD) / FALL_HEIGHT_RATING_STEP;
+        if (event_weight > FALL_HEIGHT_MAX_RATING) {
+            event_weight = FALL_HEIGHT_MAX_RATING;
+        }
+    }
+
+    return (event_weight);
+}
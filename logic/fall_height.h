@@ -0,0 +1,83 @@
+// *************************************************************************************************
+
+#ifndef FALL_HEIGHT_H_
+#define FALL_HEIGHT_H_
+
+
+// *************************************************************************************************
+// Include section
+
+
+// *************************************************************************************************
+// Prototypes section
+extern void start_fall_height(void);
+extern void stop_fall_height(void);
+extern void trigger_fall_height_baseline(void);
+extern void start_fall_height_candidate(void);
+extern void stop_fall_height_candidate(void);
+extern u8 is_fall_height_measurement(void);
+extern u8 is_fall_height_candidate(void);
+extern u8 is_fall_height_sampling(void);
+extern void do_fall_height_measurement(void);
+extern u8 rate_fall_height(void);
+
+
+// *************************************************************************************************
+// Defines section
+
+// Height drop in cm: one rating point at FALL_HEIGHT_DROP_THRESHOLD, one more per
+// FALL_HEIGHT_RATING_STEP, at most FALL_HEIGHT_MAX_RATING points
+#define FALL_HEIGHT_DROP_THRESHOLD      (50)
+#define FALL_HEIGHT_RATING_STEP         (40)
+#define FALL_HEIGHT_MAX_RATING          (2u)
+
+// Rating if the pressure sensor failed or gave no samples. Keeps the score of the other stages
+// comparable to RATING_THRESHOLD.
+#define FALL_HEIGHT_UNKNOWN_RATING      (1u)
+
+// Height (cm) per Pa pressure difference is T * 29.27m/K / p. With T in 0.1K this factor is
+// rounded to 293.
+#define FALL_HEIGHT_CM_FACTOR           (293)
+
+// Weight of the old value when altitude samples update the baseline: (new + 4 * old) / 5, like the
+// altitude filter
+#define FALL_HEIGHT_BASELINE_WEIGHT     (4u)
+
+// Pressure sampling state
+#define FALL_HEIGHT_OFF                 (0u)    // Pressure sensor is not used by the detector
+#define FALL_HEIGHT_MONITOR             (1u)    // Sensor in standby, baseline from single conversions
+#define FALL_HEIGHT_BASELINE            (2u)    // No baseline, waiting for the first sample
+#define FALL_HEIGHT_TRACK               (3u)    // Averaging samples of the stillness stage
+
+
+// *************************************************************************************************
+// Global Variable section
+struct fall_height
+{
+    // FALL_HEIGHT_OFF, FALL_HEIGHT_MONITOR, FALL_HEIGHT_BASELINE, FALL_HEIGHT_TRACK
+    u8          state;
+
+    // Pressure before the fall (Pa, 0.1K), taken with the last posture reference.
+    // 1 = baseline holds a sample.
+    u32         baseline;
+    u16         temperature;
+    u8          baseline_valid;
+
+    // 1 = single conversion for the baseline outstanding
+    u8          triggered;
+
+    // Sum and number of samples taken in the stillness stage (Pa)
+    u32         sum;
+    u8          count;
+
+    // Height drop of the last rated candidate (cm, positive = lower than before the fall)
+    s16         drop;
+};
+extern struct fall_height sFallHeight;
+
+
+// *************************************************************************************************
+// Extern section
+
+
+#endif /*FALL_HEIGHT_H_*/
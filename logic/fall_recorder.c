@@ -0,0 +1,421 @@
+// *************************************************************************************************
+// Fall event recorder. On an alarm the FIFO buffer of the fall detector is kept for the samples
+// before the alarm, the post-trigger samples are collected, and the idle loop codes the window
+// into a flash segment piece by piece. Ratings and time stamp go into the record header, so
+// thresholds can be tuned with falls recorded in the field.
+// *************************************************************************************************
+
+// *************************************************************************************************
+// Include section
+
+// system
+#include "project.h"
+
+// driver
+#include "flash.h"
+
+// logic
+#include "clock.h"
+#include "codec.h"
+#include "data_log.h"
+#include "date.h"
+#include "fall_detection.h"
+#include "fall_height.h"
+#include "fall_recorder.h"
+
+
+// *************************************************************************************************
+// Defines section
+
+#if (FALL_RECORD_PRE_SAMPLES + FALL_RECORD_POST_SAMPLES) > (FALL_DETECTION_WINDOW_IN_SAMPLES - ACC_SAMPLING_RATE / 2)
+#error "Fall record windows leave no FIFO time for the flash write"
+#endif
+#if (FALL_RECORD_HEADER_SIZE + 1 + ((FALL_RECORD_PRE_SAMPLES + FALL_RECORD_POST_SAMPLES - 1) * CODEC_MAX_SAMPLE_BITS + 7) / 8) > FLASH_SEGMENT_SIZE
+#error "Fall record does not fit into a flash segment"
+#endif
+
+
+// *************************************************************************************************
+// Global Variable section
+struct fall_recorder sFallRecord;
+
+// Coded bytes waiting to be programmed. A chunk is programmed once it holds 
+// FALL_RECORD_CHUNK_SIZE complete bytes, the last sample may add some more.
+u8 fall_record_chunk[FALL_RECORD_CHUNK_SIZE + (CODEC_MAX_SAMPLE_BITS + 7) / 8];
+struct codec_writer fall_record_writer;
+struct codec_channel fall_record_channel;
+
+
+// *************************************************************************************************
+// @fn          fall_record_address
+// @brief       Flash address of a record.
+// @param       u8 slot             Record slot
+// @return      u16                 Address of the record header
+// *************************************************************************************************
+u16 fall_record_address(u8 slot)
+{
+    return (FALL_RECORD_FLASH_START + (u16)slot * FLASH_SEGMENT_SIZE);
+}
+
+
+// *************************************************************************************************
+// @fn          increment_age
+// @brief       Counts a sample age up, sticking at 0xFFFF.
+// @param       u16 * age           Age to increment
+// @return      none
+// *************************************************************************************************
+void increment_age(u16 * age)
+{
+    if (*age != 0xFFFF) (*age)++;
+}
+
+
+// *************************************************************************************************
+// @fn          record_position
+// @brief       Converts a sample age at the end of the record to a record sample index.
+// @param       u16 age             Samples between the event and the end of the record
+//              u16 length          Samples in the record
+// @return      u16                 Index of the first sample after the event (0 = event is
+//                                  older than the record)
+// *************************************************************************************************
+u16 record_position(u16 age, u16 length)
+{
+    return ((age >= length) ? 0 : (length - age));
+}
+
+
+// *************************************************************************************************
+// @fn          reset_fall_recorder
+// @brief       Reset recorder. The newest record in flash is searched from the idle loop.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void reset_fall_recorder(void)
+{
+    sFallRecord.state               = FALL_RECORD_STATE_SCAN;
+    sFallRecord.capture             = 0;
+    sFallRecord.commit              = 0;
+    sFallRecord.candidate_begin_age = 0xFFFF;
+    sFallRecord.candidate_end_age   = 0xFFFF;
+    sFallRecord.candidate_active    = 0;
+}
+
+
+// *************************************************************************************************
+// @fn          log_fall_alarm
+// @brief       Adds the alarm to the data log: time stamp, ratings, trigger and latency.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void log_fall_alarm(void)
+{
+    u8 entry[DATA_LOG_ENTRY_SIZE];
+
+    entry[0]  = DATA_LOG_TYPE_FALL_ALARM;
+    entry[1]  = sDate.year >> 8;
+    entry[2]  = sDate.year & 0xFF;
+    entry[3]  = sDate.month;
+    entry[4]  = sDate.day;
+    entry[5]  = sTime.hour;
+    entry[6]  = sTime.minute;
+    entry[7]  = sTime.second;
+    entry[8]  = sFall.free_fall_rating;
+    entry[9]  = sFall.impact_rating;
+    entry[10] = sFall.motionlessness_rating;
+    entry[11] = sFall.posture_rating;
+    entry[12] = sFall.hw_trigger;
+    entry[13] = sFall.alarm_latency >> 8;
+    entry[14] = sFall.alarm_latency & 0xFF;
+    entry[15] = sFall.height_rating;
+    data_log_append(entry);
+}
+
+
+// *************************************************************************************************
+// @fn          start_fall_record
+// @brief       Freeze the samples before the alarm and start collecting the post-trigger
+//              samples. Called by the fall detector when the alarm is raised.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void start_fall_record(void)
+{
+    struct fall_record_header * header = &sFallRecord.header;
+
+    log_fall_alarm();
+
+    // Previous record is not in flash yet
+    if (sFallRecord.capture || sFallRecord.commit) return;
+
+    header->year                  = sDate.year;
+    header->month                 = sDate.month;
+    header->day                   = sDate.day;
+    header->hour                  = sTime.hour;
+    header->minute                = sTime.minute;
+    header->second                = sTime.second;
+    header->free_fall_rating      = sFall.free_fall_rating;
+    header->impact_rating         = sFall.impact_rating;
+    header->motionlessness_rating = sFall.motionlessness_rating;
+    header->posture_rating        = sFall.posture_rating;
+    header->height_rating         = sFall.height_rating;
+    header->height_drop           = (s8)((sFallHeight.drop > 1270) ? 127 : (sFallHeight.drop < -1280) ? -128 : (sFallHeight.drop / 10));
+    header->hw_trigger            = sFall.hw_trigger;
+    header->alarm_latency         = sFall.alarm_latency;
+    header->rate                  = ACC_SAMPLING_RATE;
+    header->candidate_rate        = ACC_CANDIDATE_SAMPLING_RATE;
+
+    // After a hardware trigger the FIFO buffer holds less history
+    header->pre_samples = FALL_RECORD_PRE_SAMPLES;
+    if (header->pre_samples > sFall.fill_count) {
+        header->pre_samples = sFall.fill_count;
+    }
+    header->post_samples = 0;
+
+    sFallRecord.post_countdown = FALL_RECORD_POST_SAMPLES;
+    sFallRecord.capture = 1;
+}
+
+
+// *************************************************************************************************
+// @fn          stop_fall_record
+// @brief       End the post-trigger window now and hand the record over to the idle loop.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void stop_fall_record(void)
+{
+    struct fall_record_header * header = &sFallRecord.header;
+    u16 length;
+
+    if (!sFallRecord.capture) return;
+    sFallRecord.capture = 0;
+
+    length = header->pre_samples + header->post_samples;
+
+    // Candidate rate range as sample index
+    if (sFallRecord.candidate_begin_age == 0xFFFF) {
+        header->candidate_start = FALL_RECORD_NONE;
+        header->candidate_end   = FALL_RECORD_NONE;
+    } else {
+        header->candidate_start = record_position(sFallRecord.candidate_begin_age, length);
+        if (sFallRecord.candidate_active) {
+            header->candidate_end = length;
+        } else {
+            header->candidate_end = record_position(sFallRecord.candidate_end_age, length);
+        }
+        if (header->candidate_end == 0) {
+            // Candidate ended before the record starts
+            header->candidate_start = FALL_RECORD_NONE;
+            header->candidate_end   = FALL_RECORD_NONE;
+        }
+    }
+
+    sFallRecord.end_age   = 0;
+    sFallRecord.remaining = length;
+    sFallRecord.first     = 1;
+    sFallRecord.commit    = 1;
+}
+
+
+// *************************************************************************************************
+// @fn          discard_fall_record
+// @brief       Drop a record that is not in flash yet. Called when the FIFO buffer is cleared.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void discard_fall_record(void)
+{
+    sFallRecord.capture = 0;
+    if (sFallRecord.commit) {
+        sFallRecord.commit = 0;
+
+        // Segment is partly programmed - the record has no magic and is erased again
+        if (sFallRecord.state == FALL_RECORD_STATE_WRITE) {
+            sFallRecord.state = FALL_RECORD_STATE_ERASE;
+        }
+    }
+}
+
+
+// *************************************************************************************************
+// @fn          record_fall_sample
+// @brief       Called for every sample written to the FIFO buffer of the fall detector.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void record_fall_sample(void)
+{
+    increment_age(&sFallRecord.candidate_begin_age);
+    increment_age(&sFallRecord.candidate_end_age);
+    increment_age(&sFallRecord.end_age);
+
+    if (sFallRecord.capture) {
+        sFallRecord.header.post_samples++;
+        if (--sFallRecord.post_countdown == 0) {
+            stop_fall_record();
+        }
+    }
+}
+
+
+// *************************************************************************************************
+// @fn          record_fall_rate
+// @brief       Called when the fall detector switches the sample rate.
+// @param       u16 rate            New sample rate (Hz)
+// @return      none
+// *************************************************************************************************
+void record_fall_rate(u16 rate)
+{
+    if (rate == ACC_CANDIDATE_SAMPLING_RATE) {
+        sFallRecord.candidate_begin_age = 0;
+        sFallRecord.candidate_active = 1;
+    } else if (sFallRecord.candidate_active) {
+        sFallRecord.candidate_end_age = 0;
+        sFallRecord.candidate_active = 0;
+    }
+}
+
+
+// *************************************************************************************************
+// @fn          is_fall_record_busy
+// @brief       Returns 1 while the recorder needs the FIFO buffer of the fall detector.
+// @param       none
+// @return      u8                  1 = record is collected or waits for flash
+// *************************************************************************************************
+u8 is_fall_record_busy(void)
+{
+    return (sFallRecord.capture || sFallRecord.commit);
+}
+
+
+// *************************************************************************************************
+// @fn          is_fall_record_pending
+// @brief       Returns 1 if the idle loop has flash work to do.
+// @param       none
+// @return      u8                  1 = call write_fall_record() instead of sleeping
+// *************************************************************************************************
+u8 is_fall_record_pending(void)
+{
+    return ((sFallRecord.state != FALL_RECORD_STATE_READY) || sFallRecord.commit);
+}
+
+
+// *************************************************************************************************
+// @fn          scan_fall_records
+// @brief       Finds the newest record in flash, the record after it is written next.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void scan_fall_records(void)
+{
+    const struct fall_record_header * header;
+    u8 slot;
+    u8 found = 0;
+
+    sFallRecord.slot = 0;
+    sFallRecord.sequence = 0;
+    for (slot = 0; slot < FALL_RECORD_SLOTS; slot++) {
+        header = (const struct fall_record_header *)fall_record_address(slot);
+        if (header->magic != FALL_RECORD_MAGIC) continue;
+
+        // Sequence numbers wrap - newer is less than half the range ahead
+        if (!found || ((s16)(header->sequence - sFallRecord.sequence) >= 0)) {
+            sFallRecord.slot = (slot + 1) % FALL_RECORD_SLOTS;
+            sFallRecord.sequence = header->sequence + 1;
+            found = 1;
+        }
+    }
+}
+
+
+// *************************************************************************************************
+// @fn          write_fall_record
+// @brief       Flash work of the recorder, one step per idle loop pass: find the next slot,
+//              erase it ahead of the next alarm, and code FALL_RECORD_CHUNK_SIZE bytes of a
+//              pending record. The header with the magic is programmed last.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void write_fall_record(void)
+{
+    u16 base = fall_record_address(sFallRecord.slot);
+    u16 back;
+    u16 length;
+    u8 sample;
+
+    switch (sFallRecord.state)
+    {
+        case FALL_RECORD_STATE_SCAN:
+            scan_fall_records();
+            if (flash_is_erased(fall_record_address(sFallRecord.slot), FLASH_SEGMENT_SIZE)) {
+                sFallRecord.state = FALL_RECORD_STATE_READY;
+            } else {
+                sFallRecord.state = FALL_RECORD_STATE_ERASE;
+            }
+            break;
+
+        case FALL_RECORD_STATE_ERASE:
+            flash_erase_segment(base);
+            sFallRecord.state = FALL_RECORD_STATE_READY;
+            break;
+
+        case FALL_RECORD_STATE_READY:
+            if (!sFallRecord.commit) break;
+            sFallRecord.address = base + FALL_RECORD_HEADER_SIZE;
+            codec_start_writer(&fall_record_writer, fall_record_chunk, sizeof(fall_record_chunk));
+            sFallRecord.state = FALL_RECORD_STATE_WRITE;
+            // no break
+
+        case FALL_RECORD_STATE_WRITE:
+            while ((sFallRecord.remaining > 0) && ((fall_record_writer.bits >> 3) < FALL_RECORD_CHUNK_SIZE)) {
+                // Oldest sample not coded yet. Give up if the FIFO buffer has overwritten it.
+                back = sFallRecord.end_age + sFallRecord.remaining - 1;
+                if (back >= FALL_DETECTION_WINDOW_IN_SAMPLES) {
+                    discard_fall_record();
+                    return;
+                }
+                sample = read_data_from_fifo_buffer(back);
+
+                if (sFallRecord.first) {
+                    codec_put_first(&fall_record_channel, &fall_record_writer, sample);
+                    sFallRecord.first = 0;
+                } else {
+                    codec_put_sample(&fall_record_channel, &fall_record_writer, sample);
+                }
+                sFallRecord.remaining--;
+            }
+
+            // Program complete bytes and keep the partial byte for the next chunk. The last
+            // byte is padded with zeros, the decoder stops after pre_samples + post_samples.
+            if (sFallRecord.remaining == 0) {
+                length = (fall_record_writer.bits + 7) >> 3;
+            } else {
+                length = fall_record_writer.bits >> 3;
+            }
+            flash_write(sFallRecord.address, fall_record_chunk, length);
+            sFallRecord.address += length;
+            if (sFallRecord.remaining > 0) codec_drop_bytes(&fall_record_writer, length);
+
+            if (sFallRecord.remaining == 0) {
+                sFallRecord.header.magic = 0xFFFF;
+                sFallRecord.header.sequence = sFallRecord.sequence;
+                sFallRecord.header.data_length = sFallRecord.address - base - FALL_RECORD_HEADER_SIZE;
+                flash_write(base, (const u8 *)&sFallRecord.header, sizeof(struct fall_record_header));
+
+                // Record is valid once the magic is programmed
+                sFallRecord.header.magic = FALL_RECORD_MAGIC;
+                flash_write(base, (const u8 *)&sFallRecord.header.magic, sizeof(u16));
+
+                // Erase the next slot before the next alarm
+                sFallRecord.sequence++;
+                sFallRecord.slot = (sFallRecord.slot + 1) % FALL_RECORD_SLOTS;
+                sFallRecord.commit = 0;
+                sFallRecord.state = FALL_RECORD_STATE_ERASE;
+            }
+            break;
+
+        default:
+            sFallRecord.state = FALL_RECORD_STATE_SCAN;
+            break;
+    }
+}
@@ -0,0 +1,138 @@
+// *************************************************************************************************
+
+#ifndef FALL_RECORDER_H_
+#define FALL_RECORDER_H_
+
+
+// *************************************************************************************************
+// Include section
+
+
+// *************************************************************************************************
+// Prototypes section
+extern void reset_fall_recorder(void);
+extern void start_fall_record(void);
+extern void stop_fall_record(void);
+extern void discard_fall_record(void);
+extern void record_fall_sample(void);
+extern void record_fall_rate(u16 rate);
+extern u8 is_fall_record_busy(void);
+extern u8 is_fall_record_pending(void);
+extern void write_fall_record(void);
+
+
+// *************************************************************************************************
+// Defines section
+
+// Flash region FALL_LOG reserved in lnk_cc430f6137.cmd, one record per segment. The oldest
+// record is overwritten.
+#define FALL_RECORD_FLASH_START         (0x8000u)
+#define FALL_RECORD_SLOTS               (4u)
+
+// Samples stored before and after the alarm. Both windows come from the FIFO buffer of the
+// fall detector, which keeps them until the record is in flash. The remaining FIFO samples are
+// the time the idle loop has to write the record.
+#define FALL_RECORD_PRE_SAMPLES         (200u)                          // 5 s at ACC_SAMPLING_RATE
+#define FALL_RECORD_POST_SECONDS        (2u)
+#define FALL_RECORD_POST_SAMPLES        (FALL_RECORD_POST_SECONDS * ACC_SAMPLING_RATE)
+
+// Record layout: header, then the samples as one codec channel (codec.h)
+#define FALL_RECORD_HEADER_SIZE         (32u)
+#define FALL_RECORD_MAGIC               (0xFA12u)
+
+// Bytes coded and programmed per idle loop pass
+#define FALL_RECORD_CHUNK_SIZE          (32u)
+
+// Candidate rate sample positions if there is no candidate in the record
+#define FALL_RECORD_NONE                (0xFFFFu)
+
+// Flash state of the recorder
+#define FALL_RECORD_STATE_SCAN          (0u)    // Find newest record after reset
+#define FALL_RECORD_STATE_ERASE         (1u)    // Erase the segment of the next record
+#define FALL_RECORD_STATE_READY         (2u)    // Segment of the next record is erased
+#define FALL_RECORD_STATE_WRITE         (3u)    // Code samples into the segment
+
+
+// *************************************************************************************************
+// Global Variable section
+
+// Record header as stored in flash. The magic is programmed last and marks a complete record.
+struct fall_record_header
+{
+    u16         magic;
+    u16         sequence;               // Increments with every record
+
+    // Time and date of the alarm
+    u16         year;
+    u8          month;
+    u8          day;
+    u8          hour;
+    u8          minute;
+    u8          second;
+
+    // Ratings and trigger of the fall
+    u8          free_fall_rating;
+    u8          impact_rating;
+    u8          motionlessness_rating;
+    u8          posture_rating;
+    u8          hw_trigger;
+    u16         alarm_latency;          // ms
+
+    // Samples before and after the alarm (FALL_UNIT_MGRAV units, oldest first)
+    u16         pre_samples;
+    u16         post_samples;
+
+    // Samples are taken with rate (Hz), the sample range candidate_start to candidate_end
+    // (excluding) with candidate_rate
+    u8          rate;
+    u8          candidate_rate;
+    u16         candidate_start;
+    u16         candidate_end;
+
+    // Coded sample bytes following the header
+    u16         data_length;
+
+    // Barometric height drop stage (fall_height.h), drop in dm saturated to 8 bit. Records
+    // written before this stage existed have 0xFF here.
+    u8          height_rating;
+    s8          height_drop;
+};
+
+struct fall_recorder
+{
+    // FALL_RECORD_STATE_SCAN, FALL_RECORD_STATE_ERASE, FALL_RECORD_STATE_READY, FALL_RECORD_STATE_WRITE
+    u8          state;
+
+    // Segment and sequence number of the next record
+    u8          slot;
+    u16         sequence;
+
+    u8          capture;                // 1 = Collecting post-trigger samples
+    u8          commit;                 // 1 = Record waits for flash
+
+    // Samples since the switch to and from the candidate rate (saturating), 1 = candidate rate
+    u16         candidate_begin_age;
+    u16         candidate_end_age;
+    u8          candidate_active;
+
+    // Samples since the end of the record (saturating)
+    u16         end_age;
+
+    // Post-trigger samples still to collect, samples still to code
+    u16         post_countdown;
+    u16         remaining;
+
+    // Flash address of the next coded byte, 1 = next sample is the first
+    u16         address;
+    u8          first;
+
+    struct fall_record_header header;
+};
+extern struct fall_recorder sFallRecord;
+
+
+// *************************************************************************************************
+// Extern section
+
+
+#endif /*FALL_RECORDER_H_*/
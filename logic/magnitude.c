@@ -0,0 +1,71 @@
+// *************************************************************************************************
+// Integer acceleration magnitude. Replaces sqrt() from math.h, so neither libm nor the
+// floating point runtime is linked for the fall detection path.
+// *************************************************************************************************
+
+// *************************************************************************************************
+// Include section
+
+// system
+#include "project.h"
+
+// logic
+#include "magnitude.h"
+
+
+// *************************************************************************************************
+// @fn          isqrt16
+// @brief       Integer square root, bit by bit (two result bits per iteration, 8 iterations max).
+//              The result is exactly floor(sqrt(value)) for the whole u16 range, so it matches
+//              the truncating (u16)sqrt(value) it replaces bit for bit.
+// @param       u16 value   Radicand
+// @return      u8          floor(sqrt(value))
+// *************************************************************************************************
+u8 isqrt16(u16 value)
+{
+    u16 root = 0;
+    u16 bit = 1u << 14;
+
+    // Start with the highest power of four not above the radicand
+    while (bit > value) {
+        bit >>= 2;
+    }
+
+    while (bit != 0) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return ((u8)root);
+}
+
+
+// *************************************************************************************************
+// @fn          acc_magnitude
+// @brief       Magnitude of an acceleration vector given as raw 8-bit two's complement axes.
+//              Error bound: the result is floor(|v|), i.e. 0 <= |v| - result < 1 LSB for all
+//              2^24 input triples. The sum of squares is at most 3 * 128^2 = 49152, so all
+//              arithmetic stays in 16 bit and the squares map to the hardware multiplier.
+// @param       u8 x, y, z  Raw acceleration data from sensor
+// @return      u8          floor(sqrt(x^2 + y^2 + z^2)), 0 .. ACC_MAGNITUDE_MAX
+// *************************************************************************************************
+u8 acc_magnitude(u8 x, u8 y, u8 z)
+{
+    u16 sum;
+
+    // Convert 2's complement negative numbers to positive numbers (-128 becomes 128)
+    if (x & BIT7) x = ~x + 1;
+    if (y & BIT7) y = ~y + 1;
+    if (z & BIT7) z = ~z + 1;
+
+    sum  = (u16)x * x;
+    sum += (u16)y * y;
+    sum += (u16)z * z;
+
+    return (isqrt16(sum));
+}
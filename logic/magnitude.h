@@ -0,0 +1,32 @@
+// *************************************************************************************************
+
+#ifndef MAGNITUDE_H_
+#define MAGNITUDE_H_
+
+
+// *************************************************************************************************
+// Include section
+
+
+// *************************************************************************************************
+// Prototypes section
+extern u8 isqrt16(u16 value);
+extern u8 acc_magnitude(u8 x, u8 y, u8 z);
+
+
+// *************************************************************************************************
+// Defines section
+
+// Largest result of acc_magnitude(): floor(sqrt(3 * 128^2)) for three axes at -128
+#define ACC_MAGNITUDE_MAX       (221u)
+
+
+// *************************************************************************************************
+// Global Variable section
+
+
+// *************************************************************************************************
+// Extern section
+
+
+#endif /*MAGNITUDE_H_*/
@@ -47,6 +47,7 @@
 #include "vti_as.h"
 #include "ports.h"
 #include "timer.h"
+#include "adc12.h"
 #include "radio.h"
 
 // logic
@@ -62,6 +63,10 @@
 #include "temperature.h"
 #include "vti_ps.h"
 #include "altitude.h"
+#include "flash.h"
+#include "data_log.h"
+#include "codec.h"
+#include <string.h>
 
 
 // *************************************************************************************************
@@ -77,11 +82,24 @@ void start_simpliciti_sync(void);
 // Each packet index requires 2 bytes, so we can have 9 packet indizes in 18 bytes usable payload
 #define BM_SYNC_BURST_PACKETS_IN_DATA		(9u)
 
+// Memory packets carry one data log entry after type and packet index
+#if (BM_SYNC_DATA_LENGTH - 3) != DATA_LOG_ENTRY_SIZE
+#error "Data log entry does not match memory packet payload"
+#endif
+
+// Connection context is kept in info flash segment B
+#define SIMPLICITI_CONTEXT_FLASH_START		(0x1900u)
+#if SIMPLICITI_CONTEXT_MAX_LENGTH + 8 > FLASH_INFO_SEGMENT_SIZE
+#error "SimpliciTI connection context does not fit into info flash segment"
+#endif
+
 
 // *************************************************************************************************
 // Global Variable section
 struct RFsmpl sRFsmpl;
 
+struct RFalert sRFalert;
+
 // flag contains status information, trigger to send data and trigger to exit SimpliciTI
 unsigned char simpliciti_flag;
 
@@ -110,6 +128,24 @@ u16		burst_packet[BM_SYNC_BURST_PACKETS_IN_DATA];
 // Current packet index
 u8		burst_packet_index;
 
+#ifdef USE_SIMPLICITI_ACCEL_BATCH
+// Batched acceleration packet: samples in packet, index of first sample and of next sample
+u8		accel_samples;
+u16		accel_first_index;
+u16		accel_sample_index;
+
+// Sample ring overflow count already accounted in accel_sample_index
+u8		accel_overflow;
+
+// Coder state of the packet
+struct codec_writer 	accel_writer;
+struct codec_channel	accel_channel[3];
+
+// Sample that did not fit into the last packet
+u8		accel_held[3];
+u8		accel_held_valid;
+#endif
+
 
 // *************************************************************************************************
 // Extern section
@@ -129,6 +165,13 @@ void reset_rf(void)
 
 	// Standard packets are 4 bytes long	
 	simpliciti_payload_length = 4;
+
+	// No fall alert sent yet
+	sRFalert.pending  = 0;
+	sRFalert.sequence = 0;
+	sRFalert.attempts = 0;
+	sRFalert.path     = SIMPLICITI_ALERT_PATH_NONE;
+	sRFalert.latency  = 0;
 }
 
 
@@ -211,11 +254,22 @@ void start_simpliciti_tx_only(simpliciti_mode_t mode)
 	// Preset simpliciti_data with mode (key or mouse click) and clear other data bytes
 	if (mode == SIMPLICITI_ACCELERATION)
 	{
+#ifdef USE_SIMPLICITI_ACCEL_BATCH
+		simpliciti_data[0] = SIMPLICITI_MOUSE_EVENTS | SIMPLICITI_ACCEL_BATCH;
+		simpliciti_payload_length = SIMPLICITI_ACCEL_BATCH_LENGTH;
+		accel_samples      = 0;
+		accel_sample_index = 0;
+		accel_overflow     = 0;
+		accel_held_valid   = 0;
+#else
 		simpliciti_data[0] = SIMPLICITI_MOUSE_EVENTS;
+		simpliciti_payload_length = 4;
+#endif
 	}
 	else
 	{
 		simpliciti_data[0] = SIMPLICITI_KEY_EVENTS;
+		simpliciti_payload_length = 4;
 	}	
 	simpliciti_data[1] = 0;
 	simpliciti_data[2] = 0;
@@ -245,7 +299,7 @@ void start_simpliciti_tx_only(simpliciti_mode_t mode)
 		if (mode == SIMPLICITI_ACCELERATION)
 		{
 			// Start acceleration sensor
-			as_start();
+			as_start(AS_RATE_40HZ, AS_RANGE_8G);
 		}
 
 		// Enter TX only routine. This will transfer button events and/or acceleration data to access point.
@@ -341,49 +395,143 @@ u8 is_rf(void)
 }
 
 
+#ifdef USE_SIMPLICITI_ACCEL_BATCH
+// *************************************************************************************************
+// @fn          pack_accel_sample
+// @brief       Code an acceleration sample into the batched packet.
+// @param       u8 * xyz		X/Y/Z acceleration data
+// @return      u8				1 = sample packed, 0 = packet is full
+// *************************************************************************************************
+u8 pack_accel_sample(u8 * xyz)
+{
+	u8 i;
+	u16 bits = 0;
+	
+	if (accel_samples == 0)
+	{
+		accel_first_index = accel_sample_index;
+		codec_start_writer(&accel_writer, &simpliciti_data[SIMPLICITI_ACCEL_BATCH_HEADER], 
+						   SIMPLICITI_ACCEL_BATCH_LENGTH - SIMPLICITI_ACCEL_BATCH_HEADER);
+		for (i=0; i<3; i++) codec_put_first(&accel_channel[i], &accel_writer, xyz[i]);
+	}
+	else
+	{
+		for (i=0; i<3; i++) bits += codec_sample_bits(&accel_channel[i], xyz[i]);
+		if (bits > codec_writer_free(&accel_writer)) return (0);
+		for (i=0; i<3; i++) codec_put_sample(&accel_channel[i], &accel_writer, xyz[i]);
+	}
+	
+	accel_samples++;
+	accel_sample_index++;
+	return (1);
+}
+
+
+// *************************************************************************************************
+// @fn          send_accel_packet
+// @brief       Complete the batched packet header and trigger sending.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void send_accel_packet(void)
+{
+	simpliciti_data[1] = accel_samples;
+	simpliciti_data[2] = accel_first_index >> 8;
+	simpliciti_data[3] = accel_first_index & 0xFF;
+	accel_samples = 0;
+	
+	// Trigger packet sending
+	simpliciti_flag |= SIMPLICITI_TRIGGER_SEND_DATA;
+}
+#endif
+
+
 // *************************************************************************************************
 // @fn          simpliciti_get_ed_data_callback
 // @brief       Callback function to read end device data from acceleration sensor (if available) 
 //				and trigger sending. Can be also be used to transmit other data at different packet rates.
 //				Please observe the applicable duty limit in the chosen ISM band.
+//				Acceleration samples are taken from the sample ring filled on DRDY. With 
+//				USE_SIMPLICITI_ACCEL_BATCH several samples are packed into each packet.
 // @param       none
 // @return      none
 // *************************************************************************************************
 void simpliciti_get_ed_data_callback(void)
 {
 	static u8 packet_counter = 0;
+	u8 xyz[3];
+	u8 sample;
 
 	if (sRFsmpl.mode == SIMPLICITI_ACCELERATION)
 	{
-		// Wait for next sample
-		Timer0_A4_Delay(CONV_MS_TO_TICKS(5));	
-
-		// Read from sensor if DRDY pin indicates new data (set in PORT2 ISR)
-		if (request.flag.acceleration_measurement && ((AS_INT_IN & AS_INT_PIN) == AS_INT_PIN))
+#ifdef USE_SIMPLICITI_ACCEL_BATCH
+		// Sample that did not fit into the last packet starts the next one
+		if (accel_held_valid)
 		{
-			// Clear flag
-			request.flag.acceleration_measurement = 0;
-			
-			// Get data from sensor
-//			as_get_data(sAccel.xyz);
-			
-			// Transmit only every 3rd data set (= 33 packets / second) 
+			xyz[0] = accel_held[0];
+			xyz[1] = accel_held[1];
+			xyz[2] = accel_held[2];
+			accel_held_valid = 0;
+			sample = 1;
+		}
+		else
+#endif
+		{
+			// Samples are read by DMA after DRDY and collected in the sample ring
+			sample = (as_get_sample(xyz) != 0);
+		}
+		
+		if (sample)
+		{
+#ifdef USE_SIMPLICITI_ACCEL_BATCH
+			// Pack samples into one packet, send it when it is full
+			if (!pack_accel_sample(xyz))
+			{
+				accel_held[0] = xyz[0];
+				accel_held[1] = xyz[1];
+				accel_held[2] = xyz[2];
+				accel_held_valid = 1;
+				send_accel_packet();
+			}
+			else if (accel_samples == SIMPLICITI_ACCEL_BATCH_SAMPLES)
+			{
+				send_accel_packet();
+			}
+#else
+			// Transmit only every 3rd data set
 			if (packet_counter++ > 1)
 			{
 				// Reset counter
 				packet_counter = 0;
 	
 				// Store XYZ data in SimpliciTI variable
-//				simpliciti_data[1] = sAccel.xyz[0];
-//				simpliciti_data[2] = sAccel.xyz[1];
-//				simpliciti_data[3] = sAccel.xyz[2];
-				simpliciti_data[1] = 0;
-                simpliciti_data[2] = 0;
-                simpliciti_data[3] = 0;
+				simpliciti_data[1] = xyz[0];
+				simpliciti_data[2] = xyz[1];
+				simpliciti_data[3] = xyz[2];
 			
 				// Trigger packet sending
 				simpliciti_flag |= SIMPLICITI_TRIGGER_SEND_DATA;
 			}
+#endif
+		}
+#ifdef USE_SIMPLICITI_ACCEL_BATCH
+		else if (as_ring_overflow != accel_overflow)
+		{
+			// Samples the ring could not take are newer than all samples read. Send the packet
+			// before the gap with the samples it has, then skip the lost samples.
+			if (accel_samples > 0) send_accel_packet();
+			accel_sample_index += (u8)(as_ring_overflow - accel_overflow);
+			accel_overflow = as_ring_overflow;
+		}
+#endif
+		else
+		{
+			// Wait in LPM3 until DMA ISR has collected the next batch of samples
+			if (!as_is_batch_ready())
+			{
+				_BIS_SR(LPM3_bits + GIE); 	
+				__no_operation();
+			}
 		}
 	}
 	else // transmit only button events
@@ -450,6 +598,7 @@ void start_simpliciti_sync(void)
 		
 	// Get updated temperature	
 	temperature_measurement(FILTER_OFF);
+	adc12_flush();
 
 	// Turn on beeper icon to show activity
 	display_symbol(LCD_ICON_BEEPER1, SEG_ON_BLINK_ON);
@@ -467,6 +616,11 @@ void start_simpliciti_sync(void)
 	
 	// Set SimpliciTI timeout to save battery power
 	sRFsmpl.timeout = SIMPLICITI_TIMEOUT; 
+	
+	// A restored link is checked with a ready-to-receive packet
+	simpliciti_data[0] = SYNC_ED_TYPE_R2R;
+	simpliciti_data[1] = 0xCB;
+	simpliciti_payload_length = 2;
 		
 	// Start SimpliciTI stack. Try to link to access point.
 	// Exit with timeout or by a button DOWN press.
@@ -570,6 +724,7 @@ void simpliciti_sync_decode_ap_cmd_callback(void)
 										break;
 		
 		case SYNC_AP_CMD_ERASE_MEMORY:	// Erase data logger memory
+										erase_data_log();
 										break;
 										
 		case SYNC_AP_CMD_EXIT:			// Exit sync mode
@@ -588,7 +743,7 @@ void simpliciti_sync_decode_ap_cmd_callback(void)
 // *************************************************************************************************
 void simpliciti_sync_get_data_callback(unsigned int index)
 {
-	u8 i;
+	u16 packets;
 	
 	// simpliciti_data[0] contains data type and needs to be returned to AP
 	switch (simpliciti_data[0])
@@ -607,6 +762,10 @@ void simpliciti_sync_get_data_callback(unsigned int index)
 										simpliciti_data[11] = sTemp.degrees & 0xFF;
 										simpliciti_data[12] = sAlt.altitude >> 8;
 										simpliciti_data[13] = sAlt.altitude & 0xFF;
+										// Number of data logger packets
+										packets = data_log_count();
+										simpliciti_data[14] = packets >> 8;
+										simpliciti_data[15] = packets & 0xFF;
 										break;
 										
 		case SYNC_ED_TYPE_MEMORY:		
@@ -615,17 +774,200 @@ void simpliciti_sync_get_data_callback(unsigned int index)
 											// Set burst packet address
 											simpliciti_data[1] = ((burst_start + index) >> 8) & 0xFF;
 											simpliciti_data[2] = (burst_start + index) & 0xFF;
-											// Assemble payload
-											for (i=3; i<BM_SYNC_DATA_LENGTH; i++) simpliciti_data[i] = index;
+											// Copy payload from data logger flash
+											data_log_read(burst_start + index, &simpliciti_data[3]);
 										} 
 										else if (burst_mode == 2)
 										{
 											// Set burst packet address
 											simpliciti_data[1] = (burst_packet[index] >> 8) & 0xFF;
 											simpliciti_data[2] = burst_packet[index] & 0xFF;
-											// Assemble payload
-											for (i=3; i<BM_SYNC_DATA_LENGTH; i++) simpliciti_data[i] = index;
+											// Copy payload from data logger flash
+											data_log_read(burst_packet[index], &simpliciti_data[3]);
 										}
 										break;
 	}
 }
+
+
+// *************************************************************************************************
+// @fn          simpliciti_load_context_callback
+// @brief       Returns the connection context saved by the last successful link.
+// @param       none
+// @return      const simpliciti_context_t *		Context in flash, 0 = no context saved
+// *************************************************************************************************
+const simpliciti_context_t * simpliciti_load_context_callback(void)
+{
+	const simpliciti_context_t * context = (const simpliciti_context_t *)SIMPLICITI_CONTEXT_FLASH_START;
+	
+	if ((context->magic != SIMPLICITI_CONTEXT_MAGIC) || (context->length > SIMPLICITI_CONTEXT_MAX_LENGTH))
+	{
+		return (0);
+	}
+	return (context);
+}
+
+
+// *************************************************************************************************
+// @fn          simpliciti_save_context_callback
+// @brief       Saves the connection context to info flash. Flash is only written when the context
+//				has changed.
+// @param       const simpliciti_context_t * context		Context to save
+// @return      none
+// *************************************************************************************************
+void simpliciti_save_context_callback(const simpliciti_context_t * context)
+{
+	if (memcmp((const void *)SIMPLICITI_CONTEXT_FLASH_START, context, sizeof(simpliciti_context_t)) == 0) return;
+	
+	flash_erase_segment(SIMPLICITI_CONTEXT_FLASH_START);
+	flash_write(SIMPLICITI_CONTEXT_FLASH_START, (const u8 *)context, sizeof(simpliciti_context_t));
+}
+
+
+// *************************************************************************************************
+// @fn          simpliciti_erase_context_callback
+// @brief       Erases the saved connection context. The next start joins and links again.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void simpliciti_erase_context_callback(void)
+{
+	if (!simpliciti_load_context_callback()) return;
+	
+	flash_erase_segment(SIMPLICITI_CONTEXT_FLASH_START);
+}
+
+
+// *************************************************************************************************
+// @fn          request_fall_alert
+// @brief       Note the time of a detected fall. The alert is sent by send_fall_alert().
+// @param       none
+// @return      none
+// *************************************************************************************************
+void request_fall_alert(void)
+{
+	sRFalert.detect_time  = sTime.system_time;
+	sRFalert.detect_ticks = TA0R;
+	sRFalert.pending      = 1;
+}
+
+
+// *************************************************************************************************
+// @fn          is_fall_alert_pending
+// @brief       Returns 1 if a detected fall waits for send_fall_alert().
+// @param       none
+// @return      u8
+// *************************************************************************************************
+u8 is_fall_alert_pending(void)
+{
+	return (sRFalert.pending);
+}
+
+
+// *************************************************************************************************
+// @fn          fall_alert_elapsed_ms
+// @brief       Time since the fall was detected. TA0 counts ACLK ticks and wraps every 2 seconds,
+//				the system time tells the number of wraps.
+// @param       none
+// @return      u16		Elapsed time (ms), 0xFFFF if longer
+// *************************************************************************************************
+u16 fall_alert_elapsed_ms(void)
+{
+	s32 seconds = (s32)(sTime.system_time - sRFalert.detect_time);
+	u16 ticks   = TA0R - sRFalert.detect_ticks;
+	u32 elapsed;
+	
+	if (seconds > 60) return (0xFFFF);
+	
+	// Add the wraps that bring the tick count closest to the elapsed seconds
+	elapsed = ticks;
+	if (seconds * 32768 > (s32)ticks)
+	{
+		elapsed += ((u32)(seconds * 32768 - ticks) + 32768) & 0xFFFF0000;
+	}
+	elapsed = (elapsed * 1000) >> 15;
+	
+	return ((elapsed > 0xFFFF) ? 0xFFFF : (u16)elapsed);
+}
+
+
+// *************************************************************************************************
+// @fn          send_fall_alert
+// @brief       Wake the radio and send a fall alert on the link to the access point, with retries 
+//				bounded by SIMPLICITI_ALERT_ATTEMPTS. With USE_SIMPLICITI_BROADCAST_ALERT an alert
+//				that was not acknowledged is broadcast as well. The result and the time from 
+//				detection to acknowledgement are kept in sRFalert and added to the data log.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void send_fall_alert(void)
+{
+	u8 entry[DATA_LOG_ENTRY_SIZE];
+	u8 i;
+	
+	sRFalert.pending = 0;
+	sRFalert.attempts = 0;
+	sRFalert.path = SIMPLICITI_ALERT_PATH_NONE;
+	
+	// Radio is busy or battery voltage is too low for radio operation
+	if (is_rf() || sys.flag.low_battery)
+	{
+		sRFalert.latency = 0xFFFF;
+	}
+	else
+	{
+		// Compact alert packet
+		simpliciti_data[0] = SIMPLICITI_FALL_ALERT;
+		simpliciti_data[1] = sRFalert.sequence;
+		simpliciti_data[2] = sFall.free_fall_rating + sFall.impact_rating + sFall.motionlessness_rating + sFall.posture_rating
+		                     + sFall.height_rating;
+		simpliciti_data[3] = sFall.hw_trigger;
+		simpliciti_data[4] = sFall.alarm_latency >> 8;
+		simpliciti_data[5] = sFall.alarm_latency & 0xFF;
+	
+		// Prepare radio for RF communication
+		open_radio();
+		sRFsmpl.mode = SIMPLICITI_ALERT;
+		
+		// Link first, the stock access point acknowledges it
+		sRFalert.attempts = simpliciti_send_alert(SIMPLICITI_FALL_ALERT_LENGTH);
+		if (sRFalert.attempts > 0) sRFalert.path = SIMPLICITI_ALERT_PATH_LINK;
+		
+#ifdef USE_SIMPLICITI_BROADCAST_ALERT
+		if (sRFalert.attempts == 0)
+		{
+			// Broadcast listeners cannot see the sender address
+			for (i=0; i<4; i++) simpliciti_data[SIMPLICITI_FALL_ALERT_LENGTH + i] = simpliciti_ed_address[i];
+			
+			// Does not depend on a joined access point
+			sRFalert.attempts = simpliciti_broadcast_alert(SIMPLICITI_FALL_ALERT_BROADCAST_LENGTH);
+			if (sRFalert.attempts > 0) sRFalert.path = SIMPLICITI_ALERT_PATH_BROADCAST;
+		}
+#endif
+		
+		if (sRFalert.attempts > 0)
+		{
+			sRFalert.latency = fall_alert_elapsed_ms();
+		}
+		else
+		{
+			sRFalert.latency = 0xFFFF;
+		}
+		
+		// Powerdown radio
+		sRFsmpl.mode = SIMPLICITI_OFF;
+		close_radio();
+	}
+	
+	// Report result in data log
+	entry[0] = DATA_LOG_TYPE_FALL_ALERT;
+	entry[1] = sRFalert.sequence;
+	entry[2] = sRFalert.attempts;
+	entry[3] = sRFalert.latency >> 8;
+	entry[4] = sRFalert.latency & 0xFF;
+	entry[5] = sRFalert.path;
+	for (i=6; i<DATA_LOG_ENTRY_SIZE; i++) entry[i] = 0;
+	data_log_append(entry);
+	
+	sRFalert.sequence++;
+}
@@ -51,6 +51,9 @@ extern void display_ppt(u8 line, u8 update);
 extern void display_sync(u8 line, u8 update);
 extern void send_smpl_data(u16 data);
 extern u8 is_rf(void);
+extern void request_fall_alert(void);
+extern void send_fall_alert(void);
+extern u8 is_fall_alert_pending(void);
 
 
 // *************************************************************************************************
@@ -62,7 +65,8 @@ typedef enum
   SIMPLICITI_OFF = 0,       // Not connected
   SIMPLICITI_ACCELERATION,	// Transmitting acceleration data and button events
   SIMPLICITI_BUTTONS,		// Transmitting button events
-  SIMPLICITI_SYNC			// Syncing
+  SIMPLICITI_SYNC,			// Syncing
+  SIMPLICITI_ALERT			// Sending fall alert
 } simpliciti_mode_t;
 
 // Stop SimpliciTI transmission after 60 minutes to save power
@@ -76,13 +80,35 @@ typedef enum
 // SimpliciTI mode flag
 #define SIMPLICITI_MOUSE_EVENTS			(0x01)
 #define SIMPLICITI_KEY_EVENTS			(0x02)
+#define SIMPLICITI_FALL_ALERT			(0x04)
+#define SIMPLICITI_ACCEL_BATCH			(0x08)
+
+// Batched acceleration packet: mode, sample count, index of first sample (2 bytes), then the 
+// X/Y/Z samples coded as three codec channels (codec.h), X/Y/Z interleaved. The packet takes 
+// samples until the next one does not fit, up to SIMPLICITI_ACCEL_BATCH_SAMPLES. Sample index 
+// counts sensor samples since start, including samples lost in the sample ring, so the host 
+// can time each sample from the sample rate.
+#define SIMPLICITI_ACCEL_BATCH_HEADER	(4u)
+#define SIMPLICITI_ACCEL_BATCH_SAMPLES	(20u)
+#define SIMPLICITI_ACCEL_BATCH_LENGTH	(SIMPLICITI_MAX_APP_PAYLOAD_LENGTH)
+
+// Fall alert packet: type, sequence, rating sum, hardware trigger, alarm latency (ms, 2 bytes)
+#define SIMPLICITI_FALL_ALERT_LENGTH	(6u)
+
+// Broadcast fall alert packet: fall alert packet followed by the device address (4 bytes)
+#define SIMPLICITI_FALL_ALERT_BROADCAST_LENGTH	(SIMPLICITI_FALL_ALERT_LENGTH + 4u)
+
+// Path of the acknowledged fall alert
+#define SIMPLICITI_ALERT_PATH_NONE		(0u)
+#define SIMPLICITI_ALERT_PATH_BROADCAST	(1u)
+#define SIMPLICITI_ALERT_PATH_LINK		(2u)
 
 
 // *************************************************************************************************
 // Global Variable section
 struct RFsmpl
 {
-	// SIMPLICITI_OFF, SIMPLICITI_ACCELERATION, SIMPLICITI_BUTTONS
+	// SIMPLICITI_OFF, SIMPLICITI_ACCELERATION, SIMPLICITI_BUTTONS, SIMPLICITI_SYNC, SIMPLICITI_ALERT
 	simpliciti_mode_t 	mode;
 	
 	// Timeout until SimpliciTI transmission is automatically stopped
@@ -90,6 +116,26 @@ struct RFsmpl
 };
 extern struct RFsmpl sRFsmpl;
 
+struct RFalert
+{
+	// 1 = Fall was detected, alert is not sent yet
+	u8					pending;
+	
+	// Increments with every alert
+	u8					sequence;
+	
+	// Time of detection (system time and TA0 ticks)
+	u32					detect_time;
+	u16					detect_ticks;
+	
+	// Last alert: attempt that was acknowledged (0 = no acknowledgement), path of the 
+	// acknowledged alert and time from detection to acknowledgement (ms)
+	u8					attempts;
+	u8					path;
+	u16					latency;
+};
+extern struct RFalert sRFalert;
+
 extern unsigned char simpliciti_flag;
 
 // *************************************************************************************************
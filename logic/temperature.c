@@ -47,7 +47,6 @@
 #include "ports.h"
 #include "display.h"
 #include "adc12.h"
-#include "timer.h"
 
 // logic
 #include "user.h"
@@ -91,29 +90,44 @@ void reset_temp_measurement(void)
 
 // *************************************************************************************************
 // @fn          temperature_measurement
-// @brief       Init ADC12. Do single conversion of temperature sensor voltage. Turn off ADC12.
-// @param       none
+// @brief       Queue a conversion of the temperature sensor voltage. The result is stored by
+//				store_temperature().
+// @param       u8 filter		FILTER_ON, FILTER_OFF
 // @return      none
 // *************************************************************************************************
 void temperature_measurement(u8 filter)
 {
-	u16 adc_result;
+	// An unfiltered request wins over a filtered one for the same conversion
+	if (sTemp.filter_pending == 0) 	sTemp.filter = filter;
+	else if (filter == FILTER_OFF)	sTemp.filter = FILTER_OFF;
+	
+	sTemp.filter_pending = adc12_request_conversion(ADC12INCH_10, store_temperature);
+}
+
+
+// *************************************************************************************************
+// @fn          store_temperature
+// @brief       Convert and store a temperature sensor conversion result.
+// @param       u16 adc_result		ADC12 result of channel 10
+// @return      none
+// *************************************************************************************************
+void store_temperature(u16 adc_result)
+{
 	volatile s32 temperature;
 	
-	// Convert internal temperature diode voltage 
-	adc_result = adc12_single_conversion(REFVSEL_0, ADC12SHT0_8, ADC12INCH_10);
+	sTemp.filter_pending = 0;
 	
 	// Convert ADC value to "xx.x C"
  	// Temperature in Celsius
-    // ((A10/4096*1500mV) - 680mV)*(1/2.25mV) = (A10/4096*667) - 302
-    // = (A10 - 1855) * (667 / 4096)
-    temperature = (((s32)((s32)adc_result-1855))*667*10)/4096;
+    // ((A10/4096*2000mV) - 680mV)*(1/2.25mV) = (A10/4096*889) - 302
+    // = (A10 - 1393) * (889 / 4096)
+    temperature = (((s32)((s32)adc_result-1393))*889*10)/4096;
 	
 	// Add temperature offset
 	temperature += sTemp.offset;	
 	
 	// Store measured temperature 
-	if (filter == FILTER_ON)
+	if (sTemp.filter == FILTER_ON)
 	{
 		// Change temperature in 0.1 steps towards measured value
 		if (temperature > sTemp.degrees)		sTemp.degrees += 1;
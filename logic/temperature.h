@@ -47,6 +47,7 @@
 extern void reset_temp_measurement(void);
 extern u8 is_temp_measurement(void);
 extern void temperature_measurement(u8 filter);
+extern void store_temperature(u16 adc_result);
 
 // menu functions
 extern void mx_temperature(u8 line);
@@ -67,6 +68,9 @@ struct temp
 	s16		degrees;
 	// User set calibration value (C) in 2.1 format
 	s16		offset;
+	// Filter of the queued conversion (FILTER_ON, FILTER_OFF), 1 = conversion queued
+	u8		filter;
+	u8		filter_pending;
 };
 extern struct temp sTemp;
 
@@ -48,6 +48,7 @@
 #include "vti_ps.h"
 #include "ports.h"
 #include "timer.h"
+#include "adc12.h"
 
 // logic
 #include "fall_detection.h"
@@ -164,11 +165,12 @@ void test_mode(void)
 								{
 									Timer0_A4_Delay(CONV_MS_TO_TICKS(250));
 									temperature_measurement(FILTER_OFF);
+									adc12_flush();
 									display_temperature(LINE1, DISPLAY_LINE_UPDATE_PARTIAL);
 								}
 								break;
 						case 3: // Acceleration measurement
-								as_start();
+								as_start(AS_RATE_40HZ, AS_RANGE_8G);
 								for (i=0; i<4; i++)
 								{
 									Timer0_A4_Delay(CONV_MS_TO_TICKS(250));
@@ -69,7 +69,7 @@
 
 // *************************************************************************************************
 // Extern section
-extern void idle_loop(void);
+extern void task_yield(void);
 
 
 // *************************************************************************************************
@@ -110,9 +110,6 @@ void set_value(s32 * value, u8 digits, u8 blanks, s32 limitLow, s32 limitHigh, u
 	// Clear blink memory
 	clear_blink_mem();
 	
-	// For safety only - buzzer on/off and button_repeat share same IRQ
-	stop_buzzer();
-	
 	// Disable stopwatch display update while function is active
 	stopwatch_state = sStopwatch.state;
 	sStopwatch.state = STOPWATCH_HIDE;
@@ -247,8 +244,8 @@ void set_value(s32 * value, u8 digits, u8 blanks, s32 limitLow, s32 limitHigh, u
 			update = 0;
 		}
 		
-		// Call idle loop to serve background tasks
-		idle_loop();
+		// Let sensor, alert and storage tasks run while waiting for buttons
+		task_yield();
 		
 	}
 	
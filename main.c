@@ -51,6 +51,8 @@
 #include "buzzer.h"
 #include "ports.h"
 #include "timer.h"
+#include "adc12.h"
+#include "event.h"
 #include "pmm.h"
 #include "rf1a.h"
 
@@ -64,6 +66,9 @@
 #include "altitude.h"
 #include "battery.h"
 #include "fall_detection.h"
+#include "fall_height.h"
+#include "fall_recorder.h"
+#include "data_log.h"
 #ifdef USE_BLUEROBIN
 #include "bluerobin.h"
 #endif //USE_BLUEROBIN
@@ -77,9 +82,17 @@
 void init_application(void);
 void init_global_variables(void);
 void wakeup_event(void);
-void process_requests(void);
+void process_events(void);
 void display_update(void);
 void idle_loop(void);
+void run_tasks(u8 limit);
+void task_yield(void);
+u8 is_sensor_task(void);
+void sensor_task(void);
+u8 is_storage_task(void);
+void storage_task(void);
+u8 is_ui_task(void);
+u8 is_display_task(void);
 void configure_ports(void);
 void read_calibration_values(void);
 
@@ -90,6 +103,18 @@ void read_calibration_values(void);
 // Number of calibration data bytes in INFOA memory
 #define CALIBRATION_DATA_LENGTH		(13u)
 
+// Task priorities, 0 is the highest. Tasks run to completion, a higher priority task that is
+// ready always runs first. Long running tasks call task_yield() at their wait points.
+#define TASK_SENSOR					(0u)	// ADC results, ISR events: sensor data and fall detection
+#define TASK_ALERT					(1u)	// Fall alert transmission
+#define TASK_STORAGE				(2u)	// Fall record and data log flash writes
+#define TASK_UI						(3u)	// Button events and menus, set_value()
+#define TASK_DISPLAY				(4u)	// Display update
+#define TASK_COUNT					(5u)
+
+// Priority while no task runs
+#define TASK_IDLE					(TASK_COUNT)
+
 
 // *************************************************************************************************
 // Global Variable section
@@ -97,9 +122,6 @@ void read_calibration_values(void);
 // Variable holding system internal flags
 volatile s_system_flags sys;
 
-// Variable holding flags set by logic modules 
-volatile s_request_flags request;
-
 // Variable holding message flags
 volatile s_message_flags message;
 
@@ -111,6 +133,28 @@ u8 rf_frequoffset;
 void (*fptr_lcd_function_line1)(u8 line, u8 update);
 void (*fptr_lcd_function_line2)(u8 line, u8 update);
 
+// Task table in priority order
+struct task
+{
+	// Returns 1 if the task has work to do
+	u8		(*is_ready)(void);
+	
+	// Does the work, returns when done or after one piece of work
+	void	(*run)(void);
+};
+
+const struct task tasks[TASK_COUNT] = 
+{
+	{ is_sensor_task,			sensor_task },			// TASK_SENSOR
+	{ is_fall_alert_pending,	send_fall_alert },		// TASK_ALERT
+	{ is_storage_task,			storage_task },			// TASK_STORAGE
+	{ is_ui_task,				wakeup_event },			// TASK_UI
+	{ is_display_task,			display_update },		// TASK_DISPLAY
+};
+
+// Priority of the running task
+u8 task_priority = TASK_IDLE;
+
 
 // *************************************************************************************************
 // Extern section
@@ -139,20 +183,14 @@ int main(void)
 	// Branch to welcome screen
 //	test_mode();
 	
-	// Main control loop: wait in low power mode until some event needs to be processed
+	// Main control loop: run ready tasks by priority, wait in low power mode until some 
+	// task is ready again
 	while(1)
 	{
+		run_tasks(TASK_IDLE);
+		
 		// When idle go to LPM3
     	idle_loop();
-
-    	// Process wake-up events
-    	if (button.all_flags || sys.all_flags) wakeup_event();
-    	
-    	// Process actions requested by logic modules
-    	if (request.all_flags) process_requests();
-    	
-    	// Before going to LPM3, update display
-    	if (display.all_flags) display_update();	
  	}	
 }
 
@@ -316,7 +354,6 @@ void init_global_variables(void)
 	// Init system flags
 	button.all_flags 	= 0;
 	sys.all_flags 		= 0;
-	request.all_flags 	= 0;
 	display.all_flags 	= 0;
 	message.all_flags	= 0;
 	
@@ -349,6 +386,12 @@ void init_global_variables(void)
 	// Reset altitude measurement
 	reset_altitude_measurement();
 
+	// Reset fall event recorder
+	reset_fall_recorder();
+
+	// Reset data logger
+	reset_data_log();
+
 #ifdef USE_BLUEROBIN
 	// Reset BlueRobin stack
 	reset_bluerobin();
@@ -480,6 +523,12 @@ void wakeup_event(void)
 			// Clear button flag	
 			button.flag.down = 0;
 		}			
+		// Other events (BACKLIGHT) have no menu function ----------------------------------------
+		// Clear them, else the UI task stays ready
+		else
+		{
+			button.all_flags = 0;
+		}
 	}
 	
 	// Process internal events
@@ -505,30 +554,42 @@ void wakeup_event(void)
 
 
 // *************************************************************************************************
-// @fn          process_requests
-// @brief       Process requested actions outside ISR context.
+// @fn          process_events
+// @brief       Process events posted by ISRs outside ISR context, in the order they were posted.
 // @param       none
 // @return      none
 // *************************************************************************************************
-void process_requests(void)
+void process_events(void)
 {
-	// Do temperature measurement
-	if (request.flag.temperature_measurement) temperature_measurement(FILTER_ON);
-	
-	// Do pressure measurement
-  	if (request.flag.altitude_measurement) do_altitude_measurement(FILTER_ON);
-	
-	// Do fall detection if new acceleration data is present
-	if (request.flag.acceleration_measurement) do_fall_detection();
+	struct event event;
 	
-	// Do voltage measurement
-	if (request.flag.voltage_measurement) battery_measurement();
-	
-	// Generate alarm (two signals every second)
-	if (request.flag.buzzer) start_buzzer(2, BUZZER_ON_TICKS, BUZZER_OFF_TICKS);
-	
-	// Reset request flag
-	request.all_flags = 0;
+	while (get_event(&event))
+	{
+		switch (event.type)
+		{
+			// Do temperature measurement
+			case EVENT_TEMPERATURE:		temperature_measurement(FILTER_ON);
+										break;
+			
+			// Do pressure measurement, samples go to the fall detector while it runs (it passes them on)
+			case EVENT_PRESSURE:		if (is_fall_height_measurement())	do_fall_height_measurement();
+										else								do_altitude_measurement(FILTER_ON);
+										break;
+			
+			// Do fall detection if new acceleration data is present
+			case EVENT_ACCELERATION:
+			case EVENT_FREE_FALL:		do_fall_detection();
+										break;
+			
+			// Do voltage measurement
+			case EVENT_VOLTAGE:			battery_measurement();
+										break;
+			
+			// Generate alarm (two signals every second)
+			case EVENT_BUZZER:			start_buzzer(2, BUZZER_ON_TICKS, BUZZER_OFF_TICKS);
+										break;
+		}
+	}
 }
 
 
@@ -638,14 +699,31 @@ void to_lpm(void)
 
 // *************************************************************************************************
 // @fn          idle_loop
-// @brief       Go to LPM. Service watchdog timer when waking up.
+// @brief       Go to LPM unless a task of higher priority than the running one is ready. Service 
+//				watchdog timer when waking up.
 // @param       none
 // @return      none
 // *************************************************************************************************
 void idle_loop(void)
 {
-	// To low power mode
-	to_lpm();
+	u8 i;
+	
+	// Check with interrupts disabled, so an ISR making a task ready cannot slip in before LPM3
+	__disable_interrupt();
+	for (i=0; i<task_priority; i++)
+	{
+		if (tasks[i].is_ready()) break;
+	}
+	
+	if (i == task_priority)
+	{
+		// To low power mode, enables interrupts
+		to_lpm();
+	}
+	else
+	{
+		__enable_interrupt();
+	}
 
 #ifdef USE_WATCHDOG		
 	// Service watchdog
@@ -654,6 +732,131 @@ void idle_loop(void)
 }
 
 
+// *************************************************************************************************
+// @fn          run_tasks
+// @brief       Run ready tasks with a priority above "limit", highest priority first. After each
+//				task the table is checked again from the top. Each task runs at most once per call,
+//				so a task that is still ready after run() cannot starve lower priority tasks or the
+//				watchdog service in idle_loop(). It runs again on the next call.
+// @param       u8 limit		Lowest priority that is not run (TASK_IDLE = run all tasks)
+// @return      none
+// *************************************************************************************************
+void run_tasks(u8 limit)
+{
+	u8 i = 0;
+	u8 priority = task_priority;
+	u8 done = 0;
+	
+	while (i < limit)
+	{
+		if (!(done & (1u << i)) && tasks[i].is_ready())
+		{
+			done |= (1u << i);
+			task_priority = i;
+			tasks[i].run();
+			task_priority = priority;
+			i = 0;
+		}
+		else
+		{
+			i++;
+		}
+	}
+}
+
+
+// *************************************************************************************************
+// @fn          task_yield
+// @brief       Wait point of a long running task. Runs all ready tasks of higher priority, then 
+//				sleeps until the next wakeup. The calling task continues where it left off, so
+//				fall detection keeps running while e.g. set_value() waits for buttons.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void task_yield(void)
+{
+	run_tasks(task_priority);
+	idle_loop();
+}
+
+
+// *************************************************************************************************
+// @fn          is_sensor_task
+// @brief       Returns 1 if ADC12 results or ISR events wait.
+// @param       none
+// @return      u8
+// *************************************************************************************************
+u8 is_sensor_task(void)
+{
+	return (is_adc12_pending() || is_event_pending());
+}
+
+
+// *************************************************************************************************
+// @fn          sensor_task
+// @brief       Deliver ADC12 results and start queued conversions, then process ISR events.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void sensor_task(void)
+{
+	// The sequence runs while the CPU sleeps
+	if (is_adc12_pending()) process_adc12();
+	
+	if (is_event_pending()) process_events();
+}
+
+
+// *************************************************************************************************
+// @fn          is_storage_task
+// @brief       Returns 1 if fall record or data log flash work waits.
+// @param       none
+// @return      u8
+// *************************************************************************************************
+u8 is_storage_task(void)
+{
+	return (is_fall_record_pending() || is_data_log_pending());
+}
+
+
+// *************************************************************************************************
+// @fn          storage_task
+// @brief       Program one piece of a fall record or a queued data log entry. Higher priority 
+//				tasks get a turn between the pieces.
+// @param       none
+// @return      none
+// *************************************************************************************************
+void storage_task(void)
+{
+	if (is_fall_record_pending())	write_fall_record();
+	else							write_data_log();
+}
+
+
+// *************************************************************************************************
+// @fn          is_ui_task
+// @brief       Returns 1 if a button event or idle timeout waits.
+// @param       none
+// @return      u8
+// *************************************************************************************************
+u8 is_ui_task(void)
+{
+	return (button.all_flags || sys.flag.idle_timeout);
+}
+
+
+// *************************************************************************************************
+// @fn          is_display_task
+// @brief       Returns 1 if the display needs an update.
+// @param       none
+// @return      u8
+// *************************************************************************************************
+u8 is_display_task(void)
+{
+	return (display.all_flags != 0);
+}
+
+
 // *************************************************************************************************
 // @fn          read_calibration_values
 // @brief       Read calibration values for temperature measurement, voltage measurement
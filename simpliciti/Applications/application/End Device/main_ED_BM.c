@@ -32,9 +32,12 @@
 #include "mrfi.h"
 #include "nwk_types.h"
 #include "nwk_api.h"
+#include "nwk.h"
+#include "nwk_globals.h"
 #include "bsp_leds.h"
 #include "bsp_buttons.h"
 #include "simpliciti.h"
+#include <string.h>
 
 
 // *************************************************************************************************
@@ -49,7 +52,10 @@ typedef unsigned short u16;
 
 // *************************************************************************************************
 // Prototypes section
-
+static uint8_t simpliciti_resume(void);
+static uint8_t simpliciti_probe(void);
+static void simpliciti_save(void);
+static void simpliciti_invalidate(void);
 
 // *************************************************************************************************
 // Extern section
@@ -65,9 +71,139 @@ static linkID_t sLinkID1;
 
 
 
+// *************************************************************************************************
+// @fn          simpliciti_resume
+// @brief       Start SimpliciTI without join and restore the saved connection context.
+// @param       none
+// @return      uint8_t				0 = No valid context, 1 = Context restored, sLinkID1 is set.
+// *************************************************************************************************
+static uint8_t simpliciti_resume(void)
+{
+  const simpliciti_context_t * context;
+  ioctlNVObj_t nvObj;
+  ioctlToken_t token;
+  uint8_t * nvPtr;
+  uint8_t pwr;
+  
+  context = simpliciti_load_context_callback();
+  if (!context) return (0);
+  
+  if (SMPL_SUCCESS != SMPL_Resume(0)) return (0);
+  
+  // Context must have been saved by the same stack version
+  nvObj.objPtr = &nvPtr;
+  if ((SMPL_SUCCESS != SMPL_Ioctl(IOCTL_OBJ_NVOBJ, IOCTL_ACT_GET, &nvObj)) ||
+      (nvObj.objVersion != context->version) || (nvObj.objLen != context->length))
+  {
+  	// Clean up SimpliciTI stack to enable restarting
+  	sInit_done = 0;
+  	return (0);
+  }
+  
+  // First byte is the constant object version
+  memcpy(nvPtr + 1, context->nv_object + 1, nvObj.objLen - 1);
+  
+  token.tokenType = TT_LINK;
+  token.token.linkToken = context->link_token;
+  SMPL_Ioctl(IOCTL_OBJ_TOKEN, IOCTL_ACT_SET, &token);
+  
+  sLinkID1 = context->link_id;
+  
+  // Set output power to +3.3dmB
+  pwr = IOCTL_LEVEL_2;
+  SMPL_Ioctl(IOCTL_OBJ_RADIO, IOCTL_ACT_RADIO_SETPWR, &pwr);
+  
+  return (1);
+}
+
+
+
+// *************************************************************************************************
+// @fn          simpliciti_probe
+// @brief       Check that the access point still holds the restored link. simpliciti_data is sent
+//				with acknowledgement request. The access point only acknowledges frames of a link 
+//				in its connection table, so a restarted access point that has lost the link does 
+//				not. The caller presets simpliciti_data and simpliciti_payload_length with a frame
+//				the access point accepts in the current mode.
+// @param       none
+// @return      uint8_t				0 = No acknowledgement, 1 = Link acknowledged.
+// *************************************************************************************************
+static uint8_t simpliciti_probe(void)
+{
+  smplStatus_t rc;
+  
+  // Get radio ready. Wakes up in IDLE state.
+  SMPL_Ioctl( IOCTL_OBJ_RADIO, IOCTL_ACT_RADIO_AWAKE, 0);
+  
+  // Waits for the acknowledgement of the access point
+  rc = SMPL_SendOpt(sLinkID1, simpliciti_data, simpliciti_payload_length, SMPL_TXOPTION_ACKREQ);
+  
+  // Put radio back to SLEEP state
+  SMPL_Ioctl( IOCTL_OBJ_RADIO, IOCTL_ACT_RADIO_SLEEP, 0);
+  
+  return (rc == SMPL_SUCCESS);
+}
+
+
+
+// *************************************************************************************************
+// @fn          simpliciti_save
+// @brief       Save the connection context after a successful join and link.
+// @param       none
+// @return      none
+// *************************************************************************************************
+static void simpliciti_save(void)
+{
+  simpliciti_context_t context;
+  ioctlNVObj_t nvObj;
+  ioctlToken_t token;
+  uint8_t * nvPtr;
+  
+  nvObj.objPtr = &nvPtr;
+  if ((SMPL_SUCCESS != SMPL_Ioctl(IOCTL_OBJ_NVOBJ, IOCTL_ACT_GET, &nvObj)) ||
+      (nvObj.objLen > SIMPLICITI_CONTEXT_MAX_LENGTH))
+  {
+  	return;
+  }
+  
+  token.tokenType = TT_LINK;
+  SMPL_Ioctl(IOCTL_OBJ_TOKEN, IOCTL_ACT_GET, &token);
+  
+  memset(&context, 0xFF, sizeof(context));
+  context.magic      = SIMPLICITI_CONTEXT_MAGIC;
+  context.version    = nvObj.objVersion;
+  context.length     = nvObj.objLen;
+  context.link_id    = sLinkID1;
+  context.link_token = token.token.linkToken;
+  memcpy(context.nv_object, nvPtr, nvObj.objLen);
+  
+  simpliciti_save_context_callback(&context);
+}
+
+
+
+// *************************************************************************************************
+// @fn          simpliciti_invalidate
+// @brief       Drop a restored link the access point did not acknowledge. The saved context is 
+//				erased, so later starts join and link again instead of failing the same way.
+// @param       none
+// @return      none
+// *************************************************************************************************
+static void simpliciti_invalidate(void)
+{
+  simpliciti_erase_context_callback();
+  
+  // Clean up SimpliciTI stack to enable restarting
+  sInit_done = 0;
+}
+
+
+
 // *************************************************************************************************
 // @fn          simpliciti_link
-// @brief       Init hardware and try to link to access point.
+// @brief       Init hardware and try to link to access point. A saved connection context is used
+//				if the access point acknowledges simpliciti_data on the restored link, see 
+//				simpliciti_probe().
 // @param       none
 // @return      unsigned char		0 = Could not link, timeout or external cancel.
 //									1 = Linked successful.
@@ -91,6 +227,19 @@ unsigned char simpliciti_link(void)
   
   // Set flag	
   simpliciti_flag = SIMPLICITI_STATUS_LINKING;	
+  
+  // Use the saved connection context if the access point still acknowledges its link
+  if (simpliciti_resume())
+  {
+  	if (simpliciti_probe())
+  	{
+  	  simpliciti_flag = SIMPLICITI_STATUS_LINKED;
+  	  return (1);
+  	}
+  	
+  	// Access point rejected the restored link, so join and link again
+  	simpliciti_invalidate();
+  }
 	
   /* Keep trying to join (a side effect of successful initialization) until
    * successful. Toggle LEDS to indicate that joining has not occurred.
@@ -153,11 +302,214 @@ unsigned char simpliciti_link(void)
   }
   simpliciti_flag = SIMPLICITI_STATUS_LINKED;
   
+  // Next start can skip join and link
+  simpliciti_save();
+  
   return (1);
 }
 
 
 
+// *************************************************************************************************
+// @fn          simpliciti_send_alert
+// @brief       Init hardware, link to access point and send simpliciti_data with acknowledgement
+//				request. The first attempt uses the saved connection context. Join, link and send
+//				are retried from where they failed, with doubling backoff, until 
+//				SIMPLICITI_ALERT_ATTEMPTS are used up.
+// @param       unsigned char length	Number of data bytes
+// @return      unsigned char			0 = No acknowledgement.
+//										1..SIMPLICITI_ALERT_ATTEMPTS = Attempt that was acknowledged.
+// *************************************************************************************************
+unsigned char simpliciti_send_alert(unsigned char length)
+{
+  addr_t lAddr;
+  uint8_t i;
+  uint8_t pwr;
+  uint8_t attempt;
+  uint8_t joined = 0;
+  uint8_t linked = 0;
+  uint8_t resumed;
+  uint8_t stale = 0;
+  uint16_t backoff = SIMPLICITI_ALERT_BACKOFF_MS;
+  smplStatus_t rc;
+  
+  // Configure timer
+  BSP_InitBoard();
+  
+  // Change network address to value set in calling function
+  for (i=0; i<NET_ADDR_SIZE; i++)
+  {
+    lAddr.addr[i] = simpliciti_ed_address[i];
+  }
+  SMPL_Ioctl(IOCTL_OBJ_ADDR, IOCTL_ACT_SET, &lAddr);
+  
+  // Set flag	
+  simpliciti_flag = SIMPLICITI_STATUS_LINKING;	
+
+  // Saved connection context skips join and link
+  resumed = simpliciti_resume();
+  if (resumed)
+  {
+  	joined = 1;
+  	linked = 1;
+  	simpliciti_flag = SIMPLICITI_STATUS_LINKED;
+  }
+
+  for (attempt=1; attempt<=SIMPLICITI_ALERT_ATTEMPTS; attempt++)
+  {
+    if (!joined && (SMPL_SUCCESS == SMPL_Init(0)))
+    {
+      joined = 1;
+      
+      // Set output power to +3.3dmB
+      pwr = IOCTL_LEVEL_2;
+      SMPL_Ioctl(IOCTL_OBJ_RADIO, IOCTL_ACT_RADIO_SETPWR, &pwr);
+    }
+    
+    if (joined && !linked && (SMPL_SUCCESS == SMPL_Link(&sLinkID1)))
+    {
+      linked = 1;
+      simpliciti_flag = SIMPLICITI_STATUS_LINKED;
+    }
+    
+    if (linked)
+    {
+      // Get radio ready. Wakes up in IDLE state.
+      SMPL_Ioctl( IOCTL_OBJ_RADIO, IOCTL_ACT_RADIO_AWAKE, 0);
+      
+      // Waits for the acknowledgement of the access point
+      rc = SMPL_SendOpt(sLinkID1, simpliciti_data, length, SMPL_TXOPTION_ACKREQ);
+      
+      // Put radio back to SLEEP state
+      SMPL_Ioctl( IOCTL_OBJ_RADIO, IOCTL_ACT_RADIO_SLEEP, 0);
+      
+      if (rc == SMPL_SUCCESS) 
+      {
+      	// Next start can skip join and link. Replaces a stale context.
+      	if (!resumed) simpliciti_save();
+      	
+		// Clean up SimpliciTI stack to enable restarting
+      	sInit_done = 0;
+      	return (attempt);
+      }
+      
+      // Access point rejected the restored link, so join and link again. The context is 
+      // erased after the alert, an erase now would delay the next attempt.
+      if (resumed)
+      {
+      	resumed = 0;
+      	stale = 1;
+      	joined = 0;
+      	linked = 0;
+      	sInit_done = 0;
+      }
+    }
+
+    // Back off before the next attempt
+    NWK_DELAY(backoff);
+    if (backoff < SIMPLICITI_ALERT_BACKOFF_MAX_MS) backoff *= 2;
+
+    // Service watchdog
+	WDTCTL = WDTPW + WDTIS__512K + WDTSSEL__ACLK + WDTCNTCL;
+  }
+  
+  // Restored link was not acknowledged and no new link replaced it
+  if (stale) simpliciti_erase_context_callback();
+  
+  // Clean up SimpliciTI stack to enable restarting
+  sInit_done = 0;
+  simpliciti_flag = SIMPLICITI_STATUS_ERROR;
+  return (0);
+}
+
+
+
+// *************************************************************************************************
+// @fn          simpliciti_broadcast_alert
+// @brief       Init hardware and broadcast simpliciti_data on the user broadcast port without join 
+//				or link. Any listening access point or host acknowledges with a 
+//				SIMPLICITI_BROADCAST_ACK frame that echoes the sequence number in simpliciti_data[1].
+// @param       unsigned char length	Number of data bytes
+// @return      unsigned char			0 = No acknowledgement.
+//										1..SIMPLICITI_BROADCAST_ATTEMPTS = Attempt that was acknowledged.
+// *************************************************************************************************
+unsigned char simpliciti_broadcast_alert(unsigned char length)
+{
+  addr_t lAddr;
+  uint8_t i;
+  uint8_t pwr;
+  uint8_t attempt;
+  uint8_t acked = 0;
+  uint8_t reply[MAX_APP_PAYLOAD];
+  ioctlRawSend_t send;
+  ioctlRawReceive_t recv;
+  
+  // Configure timer
+  BSP_InitBoard();
+  
+  // Change network address to value set in calling function
+  for (i=0; i<NET_ADDR_SIZE; i++)
+  {
+    lAddr.addr[i] = simpliciti_ed_address[i];
+  }
+  SMPL_Ioctl(IOCTL_OBJ_ADDR, IOCTL_ACT_SET, &lAddr);
+  
+  // Start stack without join, raw frames need no connection
+  SMPL_Resume(0);
+  
+  // Set output power to +3.3dmB
+  pwr = IOCTL_LEVEL_2;
+  SMPL_Ioctl(IOCTL_OBJ_RADIO, IOCTL_ACT_RADIO_SETPWR, &pwr);
+  
+  send.addr = (addr_t *)nwk_getBCastAddress();
+  send.msg  = simpliciti_data;
+  send.len  = length;
+  send.port = SMPL_PORT_USER_BCAST;
+  
+  for (attempt=1; attempt<=SIMPLICITI_BROADCAST_ATTEMPTS; attempt++)
+  {
+    // Get radio ready. Wakes up in IDLE state.
+    SMPL_Ioctl( IOCTL_OBJ_RADIO, IOCTL_ACT_RADIO_AWAKE, 0);
+    
+    if (SMPL_SUCCESS == SMPL_Ioctl(IOCTL_OBJ_RAW_IO, IOCTL_ACT_WRITE, &send))
+    {
+      // Wait shortly for acknowledgement
+      SMPL_Ioctl( IOCTL_OBJ_RADIO, IOCTL_ACT_RADIO_RXON, 0);
+      NWK_REPLY_DELAY();
+      
+      recv.port = SMPL_PORT_USER_BCAST;
+      recv.msg  = reply;
+      recv.addr = 0;
+      while (SMPL_SUCCESS == SMPL_Ioctl(IOCTL_OBJ_RAW_IO, IOCTL_ACT_READ, &recv))
+      {
+        if ((recv.len >= 2) && (reply[0] == SIMPLICITI_BROADCAST_ACK) && (reply[1] == simpliciti_data[1]))
+        {
+          acked = 1;
+        }
+      }
+    }
+    
+    // Put radio back to SLEEP state
+    SMPL_Ioctl( IOCTL_OBJ_RADIO, IOCTL_ACT_RADIO_SLEEP, 0);
+    
+    if (acked) 
+    {
+      // Clean up SimpliciTI stack to enable restarting
+      sInit_done = 0;
+      return (attempt);
+    }
+    
+    // Back off before the next attempt
+    NWK_DELAY(SIMPLICITI_BROADCAST_BACKOFF_MS * attempt);
+  }
+  
+  // Clean up SimpliciTI stack to enable restarting
+  sInit_done = 0;
+  return (0);
+}
+
+
+
 // *************************************************************************************************
 // @fn          simpliciti_main_tx_only
 // @brief       Get data through callback. Transfer data when external trigger is set.
@@ -177,8 +529,8 @@ void simpliciti_main_tx_only(void)
       // Get radio ready. Wakes up in IDLE state.
       SMPL_Ioctl( IOCTL_OBJ_RADIO, IOCTL_ACT_RADIO_AWAKE, 0);
       
-      // Acceleration / button events packets are 4 bytes long
-      SMPL_SendOpt(sLinkID1, simpliciti_data, 4, SMPL_TXOPTION_NONE);
+      // Button event packets are 4 bytes long, acceleration packets up to the maximum payload
+      SMPL_SendOpt(sLinkID1, simpliciti_data, simpliciti_payload_length, SMPL_TXOPTION_NONE);
       
       // Put radio back to SLEEP state
       SMPL_Ioctl( IOCTL_OBJ_RADIO, IOCTL_ACT_RADIO_SLEEP, 0);
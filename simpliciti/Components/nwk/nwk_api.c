@@ -87,6 +87,7 @@ uint8_t sInit_done = 0;
  * LOCAL FUNCTIONS
  */
 static uint8_t ioctlPreInitAccessIsOK(ioctlObject_t);
+static smplStatus_t initStack(uint8_t (*)(linkID_t));
 
 /******************************************************************************
  * GLOBAL VARIABLES
@@ -121,6 +122,55 @@ smplStatus_t SMPL_Init(uint8_t (*f)(linkID_t))
 {
   smplStatus_t rc;
 
+  if ((rc=initStack(f)) != SMPL_SUCCESS)
+  {
+    return rc;
+  }
+
+  /* Join. if no AP or Join fails that status is returned. */
+  rc = nwk_join();
+
+  return rc;
+}
+
+// [BM] Added stack start without join to resume a saved connection context
+/***********************************************************************************
+ * @fn          SMPL_Resume
+ *
+ * @brief       Initialize the SimpliciTI stack without joining. The application
+ *              restores a saved connection context through IOCTL_OBJ_NVOBJ and
+ *              uses its link right away.
+ *
+ * input parameters
+ * @param   f  - Pointer to call back function. See SMPL_Init().
+ *
+ * output parameters
+ *
+ * @return   Status of operation:
+ *             SMPL_SUCCESS
+ */
+smplStatus_t SMPL_Resume(uint8_t (*f)(linkID_t))
+{
+  return initStack(f);
+}
+
+/***********************************************************************************
+ * @fn          initStack
+ *
+ * @brief       Set up radio and network once. Common part of SMPL_Init() and
+ *              SMPL_Resume().
+ *
+ * input parameters
+ * @param   f  - Pointer to call back function. See SMPL_Init().
+ *
+ * output parameters
+ *
+ * @return   Status of operation.
+ */
+static smplStatus_t initStack(uint8_t (*f)(linkID_t))
+{
+  smplStatus_t rc;
+
   if (!sInit_done)
   {
     /* set up radio. */
@@ -155,10 +205,7 @@ smplStatus_t SMPL_Init(uint8_t (*f)(linkID_t))
   }
   sInit_done = 1;
 
-  /* Join. if no AP or Join fails that status is returned. */
-  rc = nwk_join();
-
-  return rc;
+  return SMPL_SUCCESS;
 }
 
 /******************************************************************************
@@ -41,6 +41,7 @@
 #define  SMPL_TXOPTION_ACKREQ     ((txOpt_t)0x01)
 
 smplStatus_t SMPL_Init(uint8_t (*)(linkID_t));
+smplStatus_t SMPL_Resume(uint8_t (*)(linkID_t));
 smplStatus_t SMPL_Link(linkID_t *);
 smplStatus_t SMPL_LinkListen(linkID_t *);
 smplStatus_t SMPL_Send(linkID_t lid, uint8_t *msg, uint8_t len);
@@ -50,7 +50,7 @@
 // SimpliciTI frequency overview
 // -----------------------------
 //
-// CC430_End_Device_433MHz.lib (433MHz ISM band)
+// ISM_LF build (433MHz ISM band)
 //
 //		* base frequency		433.92 MHz
 //		* deviation				32 kHz
@@ -60,7 +60,7 @@
 //		* output power			1.4 dBm
 //		* duty					9,6% (TX only mode, 32 packets / second)
 //
-// CC430_End_Device_868MHz.lib (868MHz ISM band)
+// ISM_EU build (868MHz ISM band)
 //
 //		* base frequency		869.525 MHz
 //		* deviation				32 kHz
@@ -70,7 +70,7 @@
 //		* output power			1.1 dBm
 //		* duty					9,6% (TX only mode, 32 packets / second)
 //
-// CC430_End_Device_915MHz.lib (915MHz ISM band)
+// ISM_US build (915MHz ISM band)
 //
 //		* base frequency		902.000 MHz
 //		* deviation				32 kHz
@@ -85,7 +85,9 @@
 // ---------------------------------------------------------------
 // Generic defines and variables
 
-// Entry point into SimpliciTI library
+// Entry point into SimpliciTI library. A restored link is checked by sending simpliciti_data 
+// (simpliciti_payload_length bytes) with acknowledgement request, so preset a frame the access 
+// point accepts in the current mode.
 extern unsigned char simpliciti_link(void);
 
 // 4 byte device address overrides device address set during compile time
@@ -97,6 +99,12 @@ extern unsigned char simpliciti_ed_address[4];
 // Data to send / receive 
 extern unsigned char simpliciti_data[SIMPLICITI_MAX_PAYLOAD_LENGTH];
 
+// Maximum application payload of one packet (MAX_APP_PAYLOAD in smpl_nwk_config.dat)
+#define SIMPLICITI_MAX_APP_PAYLOAD_LENGTH      	(19u)
+
+// Number of data bytes sent in TX only mode
+extern unsigned char simpliciti_payload_length;
+
 // Flag contains status information and triggers to send data or to exit SimpliciTI library
 // Control is done from outside SimpliciTI library
 extern unsigned char simpliciti_flag;
@@ -161,3 +169,55 @@ extern void simpliciti_sync_get_data_callback(unsigned int index);
 // Send reply packets (>0), 0=no need to reply
 extern unsigned char simpliciti_reply_count;
 
+
+// ---------------------------------------------------------------
+// SimpliciTI Alert
+
+// Join, link and send attempts share one budget. The backoff between attempts doubles up to
+// the maximum, so the time until the alert is given up is bounded.
+#define SIMPLICITI_ALERT_ATTEMPTS               (6u)
+#define SIMPLICITI_ALERT_BACKOFF_MS             (20u)
+#define SIMPLICITI_ALERT_BACKOFF_MAX_MS         (160u)
+
+// Entry point into SimpliciTI library. Sends simpliciti_data with acknowledgement request.
+// Returns the attempt that was acknowledged, 0 = no acknowledgement.
+extern unsigned char simpliciti_send_alert(unsigned char length);
+
+// Broadcast alert needs no join or link. A listener replies to the sender address on the user 
+// broadcast port with SIMPLICITI_BROADCAST_ACK and the sequence number of the alert. The backoff 
+// grows linearly, so all attempts are done within a few tens of milliseconds.
+#define SIMPLICITI_BROADCAST_ATTEMPTS           (4u)
+#define SIMPLICITI_BROADCAST_BACKOFF_MS         (3u)
+#define SIMPLICITI_BROADCAST_ACK                (0x84u)
+
+// Entry point into SimpliciTI library. Broadcasts simpliciti_data without connection.
+// Returns the attempt that was acknowledged, 0 = no acknowledgement.
+extern unsigned char simpliciti_broadcast_alert(unsigned char length);
+
+
+// ---------------------------------------------------------------
+// SimpliciTI connection context
+
+// Saved after a successful link and restored on the next start to skip join and link. 
+// The network object holds the connection table with access point address, ports and link ID.
+#define SIMPLICITI_CONTEXT_MAGIC                (0xC0u)
+#define SIMPLICITI_CONTEXT_MAX_LENGTH           (48u)
+
+typedef struct
+{
+  unsigned char magic;
+  unsigned char version;                                // Network object version
+  unsigned char length;                                 // Network object length
+  unsigned char link_id;
+  unsigned long link_token;
+  unsigned char nv_object[SIMPLICITI_CONTEXT_MAX_LENGTH];
+} simpliciti_context_t;
+
+// Callback function to read the saved context, 0 = no context saved
+extern const simpliciti_context_t * simpliciti_load_context_callback(void);
+
+// Callback function to save the context
+extern void simpliciti_save_context_callback(const simpliciti_context_t * context);
+
+// Callback function to erase the context when the access point no longer holds the link
+extern void simpliciti_erase_context_callback(void);